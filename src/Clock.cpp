@@ -5,21 +5,25 @@ void Clock::toggle() {
   running = !running;
   if (running) {
     if (resetOnStart) {
-      resetWasHit = true;
-      resetWasHitForMessage = true;
-      resetPulseGenerator.trigger(1e-3f);
+      hitReset();
     }
   } else {
     if (resetOnStop) {
-      resetWasHit = true;
-      resetWasHitForMessage = true;
-      resetPulseGenerator.trigger(1e-3f);
+      hitReset();
     }
   }
   runPulseGenerator.trigger(1e-3f);
 }
 
-inline void Clock::processButtons() {
+void Clock::hitReset() {
+  beatCount = 0;
+  resetWasHit = true;
+  resetWasHitForMessage = true;
+  resetPulseGenerator.trigger(1e-3f);
+}
+
+// Every sample, so that external triggers keep their timing
+inline void Clock::processTransportInputs() {
   if (runInputIsGate && inputs[EXT_RUN_INPUT].isConnected()) {
     if (inputs[EXT_RUN_INPUT].getVoltage() > 1.0f) {
       if (!running) {
@@ -30,18 +34,23 @@ inline void Clock::processButtons() {
         toggle();
       }
     }
-  } else {
-    if (runButtonTrigger.process(params[RUN_SWITCH_PARAM].getValue()) ||
-        (inputs[EXT_RUN_INPUT].isConnected() && externalRunTrigger.process(inputs[EXT_RUN_INPUT].getVoltage()))) {
-      toggle();
-    }
+  } else if (inputs[EXT_RUN_INPUT].isConnected() && externalRunTrigger.process(inputs[EXT_RUN_INPUT].getVoltage())) {
+    toggle();
   }
 
-  if (resetButtonTrigger.process(params[RESET_SWITCH_PARAM].getValue()) ||
-      (inputs[EXT_RESET_INPUT].isConnected() && externalResetTrigger.process(inputs[EXT_RESET_INPUT].getVoltage()))) {
-    resetWasHit = true;
-    resetWasHitForMessage = true;
-    resetPulseGenerator.trigger(1e-3f);
+  if (inputs[EXT_RESET_INPUT].isConnected() && externalResetTrigger.process(inputs[EXT_RESET_INPUT].getVoltage())) {
+    hitReset();
+  }
+}
+
+// Panel controls, at control rate
+inline void Clock::processButtons() {
+  if (runButtonTrigger.process(params[RUN_SWITCH_PARAM].getValue()) && !(runInputIsGate && inputs[EXT_RUN_INPUT].isConnected())) {
+    toggle();
+  }
+
+  if (resetButtonTrigger.process(params[RESET_SWITCH_PARAM].getValue())) {
+    hitReset();
   }
 
   if (reverseButtonTrigger.process(params[REVERSE_SWITCH_PARAM].getValue())) {
@@ -70,40 +79,118 @@ inline void Clock::processSwingInputs() {
       swing16thsFinal += (99.0f - swing16thsFinal) * swing16thsInput;
     }
   }
+  if (grooveIsStale || swing8thsFinal != grooveSwing8ths || swing16thsFinal != grooveSwing16ths) {
+    grooveIsStale = false;
+    grooveSwing8ths = swing8thsFinal;
+    grooveSwing16ths = swing16thsFinal;
+    groove.build(grooveTemplate, swing8thsFinal / 100.0f, swing16thsFinal / 100.0f);
+  }
 }
 
-inline void Clock::triggerThsByPhase(float phase, float lastPhase) {
-  float trigger8thsAtPhase = swing8thsFinal / 100.0f;
-  float triggerSecond16thAtPhase = trigger8thsAtPhase * swing16thsFinal / 100.0f;
-  float triggerFourth16thAtPhase = trigger8thsAtPhase + (1.0f - trigger8thsAtPhase) * swing16thsFinal / 100.0f;
-  if (!x2ClockGateMode || !x4ClockGateMode) {
-    if ((lastPhase < trigger8thsAtPhase && trigger8thsAtPhase <= phase) ||
-        (lastPhase > trigger8thsAtPhase && trigger8thsAtPhase >= phase)) {
-      clock8thsPulseGenerator.trigger(1e-3f);
-      clock16thsPulseGenerator.trigger(1e-3f);
-    }
+// Picked up by the audio thread on its next control tick
+void Clock::setGrooveTemplate(const GrooveTemplate &groove) {
+  grooveTemplate = groove;
+  grooveIsStale = true;
+}
+
+// Samples between the crossing and the current sample, in either direction
+static inline float crossingOffset(float lastPhase, float phase, float at) {
+  return clamp((phase - at) / (phase - lastPhase), 0.0f, 1.0f);
+}
+
+inline void Clock::setEdges(bool base, bool x2, bool x4, float offset) {
+  if (base) {
+    clockEdge = true;
+    clockEdgeOffset = offset;
+  }
+  if (x2) {
+    clock8thsEdge = true;
+    clock8thsEdgeOffset = offset;
+  }
+  if (x4) {
+    clock16thsEdge = true;
+    clock16thsEdgeOffset = offset;
   }
-  if (x2ClockGateMode) {
-    clock8thsPulse = (
-      (phase < triggerSecond16thAtPhase) ||
-      (phase >= trigger8thsAtPhase && phase < triggerFourth16thAtPhase)
-    );
-  }
-  if (x4ClockGateMode) {
-    clock16thsPulse = (
-      (phase < triggerSecond16thAtPhase / 2.0f) ||
-      (phase >= triggerSecond16thAtPhase && phase < (trigger8thsAtPhase - (trigger8thsAtPhase - triggerSecond16thAtPhase) / 2.0f)) ||
-      (phase >= trigger8thsAtPhase && phase < (triggerFourth16thAtPhase - ((triggerFourth16thAtPhase - trigger8thsAtPhase) / 2.0f))) ||
-      (phase >= triggerFourth16thAtPhase && phase < (1.0f - (1.0f - triggerFourth16thAtPhase) / 2.0f))
-    );
+}
+
+// Fires the x2 and x4 edges the phase passed since the last call, or only follows it
+inline void Clock::followGroove(float phase, bool fire) {
+  if (fire) {
+    float lastPhase = groove.position;
+    groove.advance(phase, [&](const GrooveEngine::Event &event) {
+      bool x2 = event.rises & GrooveEngine::X2_OUTPUT;
+      bool x4 = event.rises & GrooveEngine::X4_OUTPUT;
+      setEdges(false, x2, x4, crossingOffset(lastPhase, phase, event.phase));
+      if (x2 && !x2ClockGateMode) { clock8thsPulseGenerator.trigger(1e-3f); }
+      if (x4 && !x4ClockGateMode) { clock16thsPulseGenerator.trigger(1e-3f); }
+    });
   } else {
-    if ((lastPhase < triggerSecond16thAtPhase && triggerSecond16thAtPhase <= phase) ||
-        (lastPhase > triggerSecond16thAtPhase && triggerSecond16thAtPhase >= phase) ||
-        (lastPhase < triggerFourth16thAtPhase && triggerFourth16thAtPhase <= phase) ||
-        (lastPhase > triggerFourth16thAtPhase && triggerFourth16thAtPhase >= phase)) {
-      clock16thsPulseGenerator.trigger(1e-3f);
+    groove.seek(phase);
+  }
+  if (x2ClockGateMode) { clock8thsPulse = groove.gates() & GrooveEngine::X2_OUTPUT; }
+  if (x4ClockGateMode) { clock16thsPulse = groove.gates() & GrooveEngine::X4_OUTPUT; }
+}
+
+// Tempo for every channel of the V/BPS input, converted the same way as the first
+inline void Clock::processLanes(const ProcessArgs &args) {
+  float bpmParam = params[BPM_PARAM].getValue();
+  for (int c = 0; c < laneChannels; c += 4) {
+    simd::float_4 voltage = inputs[VBPS_INPUT].getVoltageSimd<simd::float_4>(c);
+    if (this->useCompatibleBPMCV) {
+      laneBpm[c / 4] = bpmParam * dsp::approxExp2_taylor5(voltage + 10.f) / 1024.f;
+    } else {
+      laneBpm[c / 4] = bpmParam + voltage * 60.0f;
     }
+    if (this->snapCV) {
+      laneBpm[c / 4] = simd::round(laneBpm[c / 4]);
+    }
+    if (reverse) {
+      laneBpm[c / 4] = -laneBpm[c / 4];
+    }
+  }
+  if (resetWasHit) {
+    lanes.reset(reverse ? 1.0f : 0.0f);
+  }
+  if (running) {
+    lanes.step(laneBpm, laneChannels, 1.0 / args.sampleRate);
+  }
+}
+
+// Assumes the tempo holds; the main oscillator is read at full precision
+inline void Clock::predictEdges(const ProcessArgs &args) {
+  double phase;
+  double cyclesPerSample;
+  if (mode == EXT_PHASE_MODE || mode == EXT_CLOCK_AND_PHASE_MODE) {
+    phase = math::eucMod(inputs[PHASE_INPUT].getVoltage() / 10.0f, 1.0f);
+    cyclesPerSample = bpm / 60.0 / args.sampleRate;
+  } else {
+    phase = std::ldexp((double)oscillator.phaseAccumulator, -64);
+    cyclesPerSample = std::ldexp((double)oscillator.phaseIncrement(1.0 / args.sampleRate), -64);
+  }
+  if (!running || cyclesPerSample == 0.0) {
+    clockNextEdge = -1.0f;
+    clock8thsNextEdge = -1.0f;
+    clock16thsNextEdge = -1.0f;
+    return;
   }
+  float edges[3];
+  groove.predictRises(phase, cyclesPerSample, edges);
+  clockNextEdge = edges[0];
+  clock8thsNextEdge = edges[1];
+  clock16thsNextEdge = edges[2];
+}
+
+// Counted in time signature units, of which a beat holds one to four
+inline void Clock::updateSongPosition(float phase) {
+  int unitsPerBeat = timeSignatureUnit / 4;
+  float units = phase * unitsPerBeat;
+  int64_t unit = beatCount * unitsPerBeat + clamp((int)units, 0, unitsPerBeat - 1);
+  barCount = unit / timeSignatureBeats;
+  if (unit % timeSignatureBeats < 0) {
+    barCount--;
+  }
+  beatInBar = (int)(unit - barCount * timeSignatureBeats);
+  barPhase = (beatInBar + units - std::floor(units)) / timeSignatureBeats;
 }
 
 inline enum Clock::Modes Clock::detectMode() {
@@ -129,6 +216,7 @@ Clock::Clock() {
   configParam(RESET_SWITCH_PARAM, 0.0f, 1.0f, 0.0f, "Reset");
   configParam(USE_COMPATIBLE_BPM_CV_PARAM, 0.0f, 1.0f, 1.0f, "External CV Mode");
   clockTracker.init();
+  controlDivider.setDivision(16);
   rightExpander.producerMessage = &rightMessages[0];
   rightExpander.consumerMessage = &rightMessages[1];
   leftExpander.producerMessage = &leftMessages[0];
@@ -136,6 +224,71 @@ Clock::Clock() {
   cleanMessage.hasClock = true;
 }
 
+static GrooveTemplate straightGroove(std::string name, int steps) {
+  GrooveTemplate groove;
+  groove.name = name;
+  groove.steps = steps;
+  return groove;
+}
+
+static json_t *grooveToJson(const GrooveTemplate &groove) {
+  json_t *grooveJ = json_object();
+  json_t *offsetsJ = json_array();
+  for (int i = 0; i < groove.steps; i++) {
+    json_array_append_new(offsetsJ, json_real(groove.offsets[i]));
+  }
+  json_object_set_new(grooveJ, "name", json_string(groove.name.c_str()));
+  json_object_set_new(grooveJ, "steps", json_integer(groove.steps));
+  json_object_set_new(grooveJ, "offsets", offsetsJ);
+  return grooveJ;
+}
+
+static bool grooveFromJson(json_t *grooveJ, GrooveTemplate &groove) {
+  json_t *nameJ = json_object_get(grooveJ, "name");
+  json_t *stepsJ = json_object_get(grooveJ, "steps");
+  json_t *offsetsJ = json_object_get(grooveJ, "offsets");
+  if (!json_is_string(nameJ) || !json_is_integer(stepsJ)) { return false; }
+  int steps = json_integer_value(stepsJ);
+  if (steps < 1 || steps > GrooveTemplate::maxSteps) { return false; }
+  groove.name = json_string_value(nameJ);
+  groove.steps = steps;
+  for (int i = 0; i < GrooveTemplate::maxSteps; i++) {
+    json_t *offsetJ = i < steps ? json_array_get(offsetsJ, i) : NULL;
+    groove.offsets[i] = offsetJ ? json_number_value(offsetJ) : 0.0f;
+  }
+  return true;
+}
+
+/*
+ * Besides the straight ones, grooves are read from the user folder every time
+ * the menu opens, e.g.
+ *   { "grooves": [ { "name": "Push", "steps": 4, "offsets": [0, -0.1, 0, -0.1] } ] }
+ */
+static std::vector<GrooveTemplate> loadGrooveTemplates() {
+  std::vector<GrooveTemplate> grooves = {
+    straightGroove("16ths", 4),
+    straightGroove("32nds", 8),
+    straightGroove("Triplets", 3),
+    straightGroove("16th Triplets", 6)
+  };
+  json_error_t error;
+  json_t *rootJ = json_load_file(asset::user("ZZC-Grooves.json").c_str(), 0, &error);
+  if (!rootJ) { return grooves; }
+  json_t *groovesJ = json_object_get(rootJ, "grooves");
+  size_t index;
+  json_t *grooveJ;
+  json_array_foreach(groovesJ, index, grooveJ) {
+    GrooveTemplate groove;
+    if (grooveFromJson(grooveJ, groove)) {
+      grooves.push_back(groove);
+    } else {
+      std::cout << "Skipping groove " << index << " in ZZC-Grooves.json" << std::endl;
+    }
+  }
+  json_decref(rootJ);
+  return grooves;
+}
+
 json_t *Clock::dataToJson() {
   json_t *rootJ = json_object();
   json_object_set_new(rootJ, "running", json_integer((int) running));
@@ -151,6 +304,13 @@ json_t *Clock::dataToJson() {
   json_object_set_new(rootJ, "useCompatibleBPMCV", json_boolean(useCompatibleBPMCV));
   json_object_set_new(rootJ, "snapCV", json_boolean(snapCV));
   json_object_set_new(rootJ, "externalClockPPQN", json_integer(externalClockPPQN));
+  json_object_set_new(rootJ, "clockTrackingBandwidth", json_real(clockTrackingBandwidth));
+  json_object_set_new(rootJ, "edgeOffsetChannels", json_boolean(edgeOffsetChannels));
+  json_object_set_new(rootJ, "nextEdgeChannels", json_boolean(nextEdgeChannels));
+  json_object_set_new(rootJ, "groove", grooveToJson(grooveTemplate));
+  json_object_set_new(rootJ, "timeSignatureBeats", json_integer(timeSignatureBeats));
+  json_object_set_new(rootJ, "timeSignatureUnit", json_integer(timeSignatureUnit));
+  json_object_set_new(rootJ, "barPhaseChannel", json_boolean(barPhaseChannel));
   return rootJ;
 }
 
@@ -168,6 +328,13 @@ void Clock::dataFromJson(json_t *rootJ) {
   json_t *useCompatibleBPMCVJ = json_object_get(rootJ, "useCompatibleBPMCV");
   json_t *snapCVJ = json_object_get(rootJ, "snapCV");
   json_t *externalClockPPQNJ = json_object_get(rootJ, "externalClockPPQN");
+  json_t *clockTrackingBandwidthJ = json_object_get(rootJ, "clockTrackingBandwidth");
+  json_t *edgeOffsetChannelsJ = json_object_get(rootJ, "edgeOffsetChannels");
+  json_t *nextEdgeChannelsJ = json_object_get(rootJ, "nextEdgeChannels");
+  json_t *grooveJ = json_object_get(rootJ, "groove");
+  json_t *timeSignatureBeatsJ = json_object_get(rootJ, "timeSignatureBeats");
+  json_t *timeSignatureUnitJ = json_object_get(rootJ, "timeSignatureUnit");
+  json_t *barPhaseChannelJ = json_object_get(rootJ, "barPhaseChannel");
   if (runningJ) { running = json_integer_value(runningJ); }
   if (reverseJ) { reverse = json_integer_value(reverseJ); }
   if (baseClockGateModeJ) { baseClockGateMode = json_boolean_value(baseClockGateModeJ); }
@@ -185,16 +352,86 @@ void Clock::dataFromJson(json_t *rootJ) {
   }
   if (snapCVJ) { snapCV = json_boolean_value(snapCVJ); }
   if (externalClockPPQNJ) { externalClockPPQN = json_integer_value(externalClockPPQNJ); }
+  if (clockTrackingBandwidthJ) { clockTrackingBandwidth = json_real_value(clockTrackingBandwidthJ); }
+  if (edgeOffsetChannelsJ) { edgeOffsetChannels = json_boolean_value(edgeOffsetChannelsJ); }
+  if (nextEdgeChannelsJ) { nextEdgeChannels = json_boolean_value(nextEdgeChannelsJ); }
+  GrooveTemplate groove;
+  if (grooveJ && grooveFromJson(grooveJ, groove)) { setGrooveTemplate(groove); }
+  if (timeSignatureBeatsJ) { timeSignatureBeats = clamp((int)json_integer_value(timeSignatureBeatsJ), 1, 32); }
+  if (timeSignatureUnitJ) {
+    int unit = json_integer_value(timeSignatureUnitJ);
+    if (unit == 4 || unit == 8 || unit == 16) { timeSignatureUnit = unit; }
+  }
+  if (barPhaseChannelJ) { barPhaseChannel = json_boolean_value(barPhaseChannelJ); }
+}
+
+inline void Clock::updateLights() {
+  if (running) {
+    lights[RUN_LED].value = 1.1f;
+  }
+  lights[INTERNAL_MODE_LED].value = (mode == INTERNAL_MODE || mode == EXT_VBPS_MODE) ? 1.0f : 0.0f;
+  lights[EXT_VBPS_MODE_LED].value = mode == EXT_VBPS_MODE ? 1.0f : 0.0f;
+  lights[EXT_CLOCK_MODE_LED].value = (mode == EXT_CLOCK_MODE || mode == EXT_CLOCK_AND_PHASE_MODE) ? 1.0f : 0.0f;
+  lights[EXT_PHASE_MODE_LED].value = (mode == EXT_PHASE_MODE || mode == EXT_CLOCK_AND_PHASE_MODE) ? 1.0f : 0.0f;
+
+  // Green once locked, turning yellow as the jitter nears the outlier window; red while acquiring
+  bool tracking = mode == EXT_CLOCK_MODE && clockTracker.freqDetected;
+  float jitterRatio = clockTracker.period > 0.0 ? clockTracker.jitter / clockTracker.period / ClockTracker::window : 0.0f;
+  lights[CLOCK_LOCK_GREEN_LED].value = tracking && clockTracker.locked ? 1.0f : 0.0f;
+  lights[CLOCK_LOCK_RED_LED].value = tracking ? (clockTracker.locked ? clamp(jitterRatio * 2.0f, 0.0f, 1.0f) : 1.0f) : 0.0f;
+
+  lights[CLOCK_LED].value = (1.0f - oscillator.phase) * (1.0f - oscillator.phase);
+  if (resetPulse) {
+    lights[RESET_LED].value = 1.1f;
+  }
+  if (bpm < 0.0f) {
+    lights[REVERSE_LED].value = 1.1f;
+  }
+}
+
+// The same transport state goes to expanders on either side
+inline void Clock::fillMessage(ZZC_TransportMessage *message) {
+  std::memcpy(message, &cleanMessage, sizeof(ZZC_TransportMessage));
+  message->clockPhase = outputs[PHASE_OUTPUT].getVoltage();
+  message->clockReset = resetWasHitForMessage;
+  message->clockFlip = clockEdge;
+  message->clockFlipOffset = clockEdgeOffset;
+  message->clock8thsEdge = clock8thsEdge;
+  message->clock8thsEdgeOffset = clock8thsEdgeOffset;
+  message->clock16thsEdge = clock16thsEdge;
+  message->clock16thsEdgeOffset = clock16thsEdgeOffset;
+  message->clockNextEdge = clockNextEdge;
+  message->clock8thsNextEdge = clock8thsNextEdge;
+  message->clock16thsNextEdge = clock16thsNextEdge;
+  message->clockBeat = beatCount;
+  message->clockBar = barCount;
+  message->clockBeatInBar = beatInBar;
+  message->clockBarPhase = barPhase;
+  message->clockBeatsPerBar = timeSignatureBeats;
+  message->clockBeatUnit = timeSignatureUnit;
 }
 
 void Clock::process(const ProcessArgs &args) {
-  lastMode = mode;
-  mode = detectMode();
+  bool controlTick = controlDivider.process();
 
-  processButtons();
-  processSwingInputs();
+  lastMode = mode;
+  if (controlTick) {
+    mode = detectMode();
+    processButtons();
+    processSwingInputs();
+    oscillator.PPQN = externalClockPPQN;
+    int channels = mode == EXT_VBPS_MODE ? clamp(inputs[VBPS_INPUT].getChannels(), 1, ClockLanes::maxLanes) : 1;
+    if (channels > laneChannels) {
+      lanes.join(laneChannels, channels, oscillator.phaseAccumulator);
+    }
+    laneChannels = channels;
+    vbpsBpmIsStale = true; // picks up the BPM knob and the CV settings
+  }
+  processTransportInputs();
 
-  oscillator.PPQN = externalClockPPQN;
+  clockEdge = false;
+  clock8thsEdge = false;
+  clock16thsEdge = false;
 
   if (mode == INTERNAL_MODE || mode == EXT_VBPS_MODE || mode == EXT_CLOCK_MODE) {
 
@@ -203,19 +440,26 @@ void Clock::process(const ProcessArgs &args) {
         clockTracker.init();
         clockTracker.freq = fabsf(bpm / 60.0f);
       }
-      clockTracker.process(args.sampleTime, inputs[CLOCK_INPUT].getVoltage());
+      clockTracker.bandwidth = clockTrackingBandwidth;
+      clockTracker.process(1.0 / args.sampleRate, inputs[CLOCK_INPUT].getVoltage());
       if (clockTracker.freqDetected) {
         bpm = clockTracker.freq * 60.0f / externalClockPPQN;
       }
     } else if (mode == EXT_VBPS_MODE) {
-      if (this->useCompatibleBPMCV) {
-        bpm = params[BPM_PARAM].getValue() * dsp::approxExp2_taylor5(inputs[VBPS_INPUT].getVoltage() + 10.f) / 1024.f;
-      } else {
-        bpm = params[BPM_PARAM].getValue() + inputs[VBPS_INPUT].getVoltage() * 60.0f;
-      }
-      if (this->snapCV) {
-        bpm = std::round(bpm);
+      float voltage = inputs[VBPS_INPUT].getVoltage();
+      if (vbpsBpmIsStale || voltage != vbpsVoltage) {
+        if (this->useCompatibleBPMCV) {
+          vbpsBpm = params[BPM_PARAM].getValue() * dsp::approxExp2_taylor5(voltage + 10.f) / 1024.f;
+        } else {
+          vbpsBpm = params[BPM_PARAM].getValue() + voltage * 60.0f;
+        }
+        if (this->snapCV) {
+          vbpsBpm = std::round(vbpsBpm);
+        }
+        vbpsVoltage = voltage;
+        vbpsBpmIsStale = false;
       }
+      bpm = vbpsBpm;
     } else {
       bpm = params[BPM_PARAM].getValue();
     }
@@ -224,7 +468,11 @@ void Clock::process(const ProcessArgs &args) {
       bpm = bpm * -1.0f;
     }
 
-    oscillator.setPitch(bpm / 60.0f);
+    oscillator.setPitch(bpm / 60.0);
+
+    if (laneChannels > 1) {
+      processLanes(args);
+    }
 
     if (running) {
 
@@ -236,15 +484,18 @@ void Clock::process(const ProcessArgs &args) {
         oscillator.adjustPhase(inputs[CLOCK_INPUT].getVoltage());
       }
 
-      bool phaseFlipped = oscillator.step(args.sampleTime);
+      bool phaseFlipped = oscillator.step(1.0 / args.sampleRate);
+      if (phaseFlipped) {
+        beatCount += oscillator.freq >= 0.0 ? 1 : -1;
+      }
 
       if (phaseFlipped || resetWasHit) {
+        setEdges(true, true, true, resetWasHit ? 0.0f : oscillator.flipOffset);
         if (!baseClockGateMode) { clockPulseGenerator.trigger(1e-3f); }
         if (!x2ClockGateMode) { clock8thsPulseGenerator.trigger(1e-3f); }
         if (!x4ClockGateMode) { clock16thsPulseGenerator.trigger(1e-3f); }
-      } else {
-        triggerThsByPhase(oscillator.phase, oscillator.lastPhase);
       }
+      followGroove(oscillator.phase, !phaseFlipped && !resetWasHit);
 
       if (resetWasHit) {
         resetWasHit = false;
@@ -253,10 +504,12 @@ void Clock::process(const ProcessArgs &args) {
     }
     if (resetWasHit) {
       oscillator.reset((reverse ? 1.0f : 0.0f));
+      groove.seek(oscillator.phase);
     }
   }
   if (mode == EXT_PHASE_MODE || mode == EXT_CLOCK_AND_PHASE_MODE) {
     bool triggered = false;
+    float triggeredOffset = 0.0f;
 
     // Trust lastExtPhase if previous step was done with PHASE_INPUT plugged in
     if (lastMode == EXT_PHASE_MODE || lastMode == EXT_CLOCK_AND_PHASE_MODE) {
@@ -269,12 +522,16 @@ void Clock::process(const ProcessArgs &args) {
           triggered = true;
         }
 
+        beatCount += delta < 0.0f ? 1 : -1;
+
         // Compensate phase flip
         if (delta < 0.0f) {
           delta = 10.0f + delta;
         } else {
           delta = delta - 10.0f;
         }
+        float past = delta > 0.0f ? inputs[PHASE_INPUT].getVoltage() : 10.0f - inputs[PHASE_INPUT].getVoltage();
+        triggeredOffset = clamp(past / fabsf(delta), 0.0f, 1.0f);
       }
       bpm = delta / args.sampleTime * 6.0f;
     }
@@ -283,20 +540,25 @@ void Clock::process(const ProcessArgs &args) {
       triggered = externalClockTrigger.process(inputs[CLOCK_INPUT].getVoltage()) && (externalClockPPQN == 1 || externalClockPPQN == 2);
     }
 
-    if (running) {
-      if (triggered) {
-        if (!baseClockGateMode) { clockPulseGenerator.trigger(1e-3f); }
-        if (!x2ClockGateMode) { clock8thsPulseGenerator.trigger(1e-3f); }
-        if (!x4ClockGateMode) { clock16thsPulseGenerator.trigger(1e-3f); }
-      } else {
-        if (lastMode == EXT_PHASE_MODE || lastMode == EXT_CLOCK_AND_PHASE_MODE) {
-          triggerThsByPhase(inputs[PHASE_INPUT].getVoltage() / 10.0f, lastExtPhase  / 10.0f);
-        }
-      }
+    if (running && triggered) {
+      setEdges(true, true, true, mode == EXT_PHASE_MODE ? triggeredOffset : 0.0f);
+      if (!baseClockGateMode) { clockPulseGenerator.trigger(1e-3f); }
+      if (!x2ClockGateMode) { clock8thsPulseGenerator.trigger(1e-3f); }
+      if (!x4ClockGateMode) { clock16thsPulseGenerator.trigger(1e-3f); }
     }
+    // Followed while stopped too, so that starting again fires nothing stale
+    bool trusted = lastMode == EXT_PHASE_MODE || lastMode == EXT_CLOCK_AND_PHASE_MODE;
+    followGroove(math::eucMod(inputs[PHASE_INPUT].getVoltage() / 10.0f, 1.0f), running && !triggered && trusted);
     lastExtPhase = inputs[PHASE_INPUT].getVoltage();
   }
 
+  predictEdges(args);
+  if (mode == EXT_PHASE_MODE || mode == EXT_CLOCK_AND_PHASE_MODE) {
+    updateSongPosition(math::eucMod(inputs[PHASE_INPUT].getVoltage() / 10.0f, 1.0f));
+  } else {
+    updateSongPosition(oscillator.phase);
+  }
+
   // Generate Pulse
   if (!baseClockGateMode) { clockPulse = clockPulseGenerator.process(args.sampleTime); }
   if (!x2ClockGateMode) { clock8thsPulse = clock8thsPulseGenerator.process(args.sampleTime); }
@@ -316,6 +578,16 @@ void Clock::process(const ProcessArgs &args) {
   }
   outputs[CLOCK_8THS_OUTPUT].setVoltage(running && clock8thsPulse ? 10.0f : 0.0f);
   outputs[CLOCK_16THS_OUTPUT].setVoltage(running && clock16thsPulse ? 10.0f : 0.0f);
+  // 10V is a whole sample
+  int clockChannels = edgeOffsetChannels ? 2 : 1;
+  outputs[CLOCK_OUTPUT].setChannels(clockChannels);
+  outputs[CLOCK_8THS_OUTPUT].setChannels(clockChannels);
+  outputs[CLOCK_16THS_OUTPUT].setChannels(clockChannels);
+  if (edgeOffsetChannels) {
+    outputs[CLOCK_OUTPUT].setVoltage(clockEdgeOffset * 10.0f, 1);
+    outputs[CLOCK_8THS_OUTPUT].setVoltage(clock8thsEdgeOffset * 10.0f, 1);
+    outputs[CLOCK_16THS_OUTPUT].setVoltage(clock16thsEdgeOffset * 10.0f, 1);
+  }
   if (runOutputIsGate) {
     outputs[RUN_OUTPUT].setVoltage(running ? 10.0f : 0.0f);
   } else {
@@ -331,22 +603,46 @@ void Clock::process(const ProcessArgs &args) {
   }
   outputs[VBPS_OUTPUT].setVoltage(bpm / 60.0f);
   outputs[VSPB_OUTPUT].setVoltage(bpm == 0.0f ? 10.0f : fminf(60.0f / fabsf(bpm), 10.0f));
+  // In seconds, like V/SPB
+  outputs[VSPB_OUTPUT].setChannels(nextEdgeChannels ? 4 : 1);
+  if (nextEdgeChannels) {
+    float nextEdges[] = { clockNextEdge, clock8thsNextEdge, clock16thsNextEdge };
+    for (int i = 0; i < 3; i++) {
+      outputs[VSPB_OUTPUT].setVoltage(nextEdges[i] < 0.0f ? 10.0f : fminf(nextEdges[i] * args.sampleTime, 10.0f), i + 1);
+    }
+  }
 
-  // Status Lights
-  if (running) {
-    lights[RUN_LED].value = 1.1f;
+  // Lanes take the second channel over
+  outputs[PHASE_OUTPUT].setChannels(barPhaseChannel && laneChannels == 1 ? 2 : 1);
+  if (barPhaseChannel && laneChannels == 1) {
+    outputs[PHASE_OUTPUT].setVoltage(barPhase * 10.0f + this->phaseOutputOffset, 1);
   }
-  lights[INTERNAL_MODE_LED].value = (mode == INTERNAL_MODE || mode == EXT_VBPS_MODE) ? 1.0f : 0.0f;
-  lights[EXT_VBPS_MODE_LED].value = mode == EXT_VBPS_MODE ? 1.0f : 0.0f;
-  lights[EXT_CLOCK_MODE_LED].value = (mode == EXT_CLOCK_MODE || mode == EXT_CLOCK_AND_PHASE_MODE) ? 1.0f : 0.0f;
-  lights[EXT_PHASE_MODE_LED].value = (mode == EXT_PHASE_MODE || mode == EXT_CLOCK_AND_PHASE_MODE) ? 1.0f : 0.0f;
 
-  lights[CLOCK_LED].value = (1.0f - oscillator.phase) * (1.0f - oscillator.phase);
-  if (resetPulse) {
-    lights[RESET_LED].value = 1.1f;
+  // One channel per lane, taking over the edge offsets; the first channel stays
+  // with the main engine, which the expanders follow as well
+  if (laneChannels > 1) {
+    outputs[PHASE_OUTPUT].setChannels(laneChannels);
   }
-  if (bpm < 0.0f) {
-    lights[REVERSE_LED].value = 1.1f;
+  outputs[VBPS_OUTPUT].setChannels(laneChannels);
+  if (laneChannels > 1) {
+    float clockVoltage = outputs[CLOCK_OUTPUT].getVoltage();
+    float phaseVoltage = outputs[PHASE_OUTPUT].getVoltage();
+    float vbpsVoltage = outputs[VBPS_OUTPUT].getVoltage();
+    outputs[CLOCK_OUTPUT].setChannels(laneChannels);
+    for (int c = 0; c < laneChannels; c += 4) {
+      simd::float_4 pulse = lanes.pulseGenerators[c / 4].process(args.sampleTime);
+      simd::float_4 gate = baseClockGateMode ? simd::float_4(lanes.phase[c / 4] < 0.5f) : pulse;
+      outputs[CLOCK_OUTPUT].setVoltageSimd(running ? simd::ifelse(gate, 10.f, 0.f) : simd::float_4(0.f), c);
+      outputs[PHASE_OUTPUT].setVoltageSimd(lanes.phase[c / 4] * 10.f + this->phaseOutputOffset, c);
+      outputs[VBPS_OUTPUT].setVoltageSimd(laneBpm[c / 4] / 60.f, c);
+    }
+    outputs[CLOCK_OUTPUT].setVoltage(clockVoltage);
+    outputs[PHASE_OUTPUT].setVoltage(phaseVoltage);
+    outputs[VBPS_OUTPUT].setVoltage(vbpsVoltage);
+  }
+
+  if (controlTick) {
+    updateLights();
   }
 
   if (rightExpander.module &&
@@ -354,9 +650,7 @@ void Clock::process(const ProcessArgs &args) {
        rightExpander.module->model == modelDiv ||
        rightExpander.module->model == modelDivExp)) {
     ZZC_TransportMessage *message = (ZZC_TransportMessage*) rightExpander.module->leftExpander.producerMessage;
-    std::memcpy(message, &cleanMessage, sizeof(ZZC_TransportMessage));
-    message->clockPhase = outputs[PHASE_OUTPUT].getVoltage();
-    message->clockReset = resetWasHitForMessage;
+    fillMessage(message);
     rightExpander.module->leftExpander.messageFlipRequested = true;
   }
 
@@ -365,9 +659,7 @@ void Clock::process(const ProcessArgs &args) {
        leftExpander.module->model == modelDiv ||
        leftExpander.module->model == modelDivExp)) {
     ZZC_TransportMessage *message = (ZZC_TransportMessage*) leftExpander.module->rightExpander.producerMessage;
-    std::memcpy(message, &cleanMessage, sizeof(ZZC_TransportMessage));
-    message->clockPhase = outputs[PHASE_OUTPUT].getVoltage();
-    message->clockReset = resetWasHitForMessage;
+    fillMessage(message);
     leftExpander.module->rightExpander.messageFlipRequested = true;
   }
 
@@ -410,6 +702,7 @@ ClockWidget::ClockWidget(Clock *module) {
 
   addInput(createInput<ZZC_PJ_Port>(Vec(45.5, 224), module, Clock::CLOCK_INPUT));
   addChild(createLight<TinyLight<GreenLight>>(Vec(67.5, 224), module, Clock::EXT_CLOCK_MODE_LED));
+  addChild(createLight<TinyLight<GreenRedLight>>(Vec(67.5, 229), module, Clock::CLOCK_LOCK_GREEN_LED));
   addInput(createInput<ZZC_PJ_Port>(Vec(80, 224), module, Clock::PHASE_INPUT));
   addChild(createLight<TinyLight<GreenLight>>(Vec(102, 224), module, Clock::EXT_PHASE_MODE_LED));
 
@@ -508,6 +801,36 @@ struct ClockResetOnStopItem : MenuItem {
   }
 };
 
+struct EdgeOffsetChannelsItem : MenuItem {
+  Clock *clock;
+  void onAction(const event::Action &e) override {
+    clock->edgeOffsetChannels ^= true;
+  }
+  void step() override {
+    rightText = CHECKMARK(clock->edgeOffsetChannels);
+  }
+};
+
+struct BarPhaseChannelItem : MenuItem {
+  Clock *clock;
+  void onAction(const event::Action &e) override {
+    clock->barPhaseChannel ^= true;
+  }
+  void step() override {
+    rightText = CHECKMARK(clock->barPhaseChannel);
+  }
+};
+
+struct NextEdgeChannelsItem : MenuItem {
+  Clock *clock;
+  void onAction(const event::Action &e) override {
+    clock->nextEdgeChannels ^= true;
+  }
+  void step() override {
+    rightText = CHECKMARK(clock->nextEdgeChannels);
+  }
+};
+
 struct RunInputTriggerItem : MenuItem {
   Clock *module;
   void onAction(const event::Action &e) override {
@@ -640,6 +963,112 @@ struct ExternalClockPPQNItem : MenuItem {
   }
 };
 
+struct TimeSignatureOptionItem : MenuItem {
+  Clock *module;
+  int beats;
+  int unit;
+  void onAction(const event::Action &e) override {
+    module->timeSignatureBeats = this->beats;
+    module->timeSignatureUnit = this->unit;
+  }
+};
+
+struct TimeSignatureItem : MenuItem {
+  Clock *module;
+  Menu *createChildMenu() override {
+    Menu *menu = new Menu;
+    std::vector<std::pair<int, int>> signatures = {
+      { 2, 4 }, { 3, 4 }, { 4, 4 }, { 5, 4 }, { 6, 4 }, { 7, 4 },
+      { 3, 8 }, { 5, 8 }, { 6, 8 }, { 7, 8 }, { 9, 8 }, { 12, 8 },
+      { 7, 16 }, { 15, 16 }
+    };
+    for (auto signature : signatures) {
+      TimeSignatureOptionItem *item = new TimeSignatureOptionItem;
+      item->text = string::f("%d/%d", signature.first, signature.second);
+      item->rightText = CHECKMARK(module->timeSignatureBeats == signature.first && module->timeSignatureUnit == signature.second);
+      item->module = module;
+      item->beats = signature.first;
+      item->unit = signature.second;
+      menu->addChild(item);
+    }
+    return menu;
+  }
+};
+
+struct GrooveOptionItem : MenuItem {
+  Clock *module;
+  GrooveTemplate groove;
+  void onAction(const event::Action &e) override {
+    module->setGrooveTemplate(this->groove);
+  }
+};
+
+struct GrooveItem : MenuItem {
+  Clock *module;
+  Menu *createChildMenu() override {
+    Menu *menu = new Menu;
+    std::vector<GrooveTemplate> grooves = loadGrooveTemplates();
+    for (size_t i = 0; i < grooves.size(); i++) {
+      if (i == 4) {
+        menu->addChild(new MenuSeparator());
+      }
+      GrooveOptionItem *item = new GrooveOptionItem;
+      item->text = grooves[i].name;
+      item->rightText = CHECKMARK(module->grooveTemplate.name == grooves[i].name);
+      item->module = module;
+      item->groove = grooves[i];
+      menu->addChild(item);
+    }
+    return menu;
+  }
+};
+
+struct ClockTrackingBandwidthOptionItem : MenuItem {
+  Clock *module;
+  float bandwidth;
+  void onAction(const event::Action &e) override {
+    module->clockTrackingBandwidth = this->bandwidth;
+  }
+};
+
+struct ClockTrackingItem : MenuItem {
+  Clock *module;
+  Menu *createChildMenu() override {
+    Menu *menu = new Menu;
+    std::vector<std::pair<std::string, float>> bandwidths = {
+      { "Smooth", 0.02f },
+      { "Balanced", 0.05f },
+      { "Responsive", 0.12f }
+    };
+    for (auto bandwidth : bandwidths) {
+      ClockTrackingBandwidthOptionItem *item = new ClockTrackingBandwidthOptionItem;
+      item->text = bandwidth.first;
+      item->rightText = CHECKMARK(module->clockTrackingBandwidth == bandwidth.second);
+      item->module = module;
+      item->bandwidth = bandwidth.second;
+      menu->addChild(item);
+    }
+    return menu;
+  }
+};
+
+struct ClockTrackingStatusItem : MenuLabel {
+  Clock *module;
+  void step() override {
+    ClockTracker &tracker = module->clockTracker;
+    if (module->mode != Clock::EXT_CLOCK_MODE) {
+      text = "External Clock: not tracking";
+    } else if (!tracker.freqDetected) {
+      text = "External Clock: waiting for pulses";
+    } else if (!tracker.locked) {
+      text = "External Clock: locking";
+    } else {
+      text = string::f("External Clock: locked, jitter %.2f ms", tracker.jitter * 1000.0f);
+    }
+    MenuLabel::step();
+  }
+};
+
 struct ExternalCVModeCompatibleOptionItem : MenuItem {
   Clock *module;
   void onAction(const event::Action &e) override {
@@ -705,6 +1134,18 @@ void ClockWidget::appendContextMenu(Menu *menu) {
   useGatesForItem->module = clock;
   menu->addChild(useGatesForItem);
 
+  GrooveItem *grooveItem = new GrooveItem;
+  grooveItem->text = "x4 Output Groove";
+  grooveItem->rightText = RIGHT_ARROW;
+  grooveItem->module = clock;
+  menu->addChild(grooveItem);
+
+  TimeSignatureItem *timeSignatureItem = new TimeSignatureItem;
+  timeSignatureItem->text = "Time Signature";
+  timeSignatureItem->rightText = RIGHT_ARROW;
+  timeSignatureItem->module = clock;
+  menu->addChild(timeSignatureItem);
+
   menu->addChild(new MenuSeparator());
 
   ClockResetOnStartItem *resetOnStartItem = createMenuItem<ClockResetOnStartItem>("Reset on Start");
@@ -737,6 +1178,18 @@ void ClockWidget::appendContextMenu(Menu *menu) {
   phaseOutputRangeItem->module = clock;
   menu->addChild(phaseOutputRangeItem);
 
+  EdgeOffsetChannelsItem *edgeOffsetChannelsItem = createMenuItem<EdgeOffsetChannelsItem>("Edge Offsets on Clock Outputs");
+  edgeOffsetChannelsItem->clock = clock;
+  menu->addChild(edgeOffsetChannelsItem);
+
+  BarPhaseChannelItem *barPhaseChannelItem = createMenuItem<BarPhaseChannelItem>("Bar Phase on Phase Output");
+  barPhaseChannelItem->clock = clock;
+  menu->addChild(barPhaseChannelItem);
+
+  NextEdgeChannelsItem *nextEdgeChannelsItem = createMenuItem<NextEdgeChannelsItem>("Time to Next Edge on V/SPB Output");
+  nextEdgeChannelsItem->clock = clock;
+  menu->addChild(nextEdgeChannelsItem);
+
   menu->addChild(new MenuSeparator());
 
   ExternalClockPPQNItem *externalClockPPQNItem = new ExternalClockPPQNItem;
@@ -745,6 +1198,16 @@ void ClockWidget::appendContextMenu(Menu *menu) {
   externalClockPPQNItem->module = clock;
   menu->addChild(externalClockPPQNItem);
 
+  ClockTrackingItem *clockTrackingItem = new ClockTrackingItem;
+  clockTrackingItem->text = "External Clock Tracking";
+  clockTrackingItem->rightText = RIGHT_ARROW;
+  clockTrackingItem->module = clock;
+  menu->addChild(clockTrackingItem);
+
+  ClockTrackingStatusItem *clockTrackingStatusItem = new ClockTrackingStatusItem;
+  clockTrackingStatusItem->module = clock;
+  menu->addChild(clockTrackingStatusItem);
+
   ExternalCVModeItem *externalCVModeItem = new ExternalCVModeItem;
   externalCVModeItem->text = "External CV Mode";
   externalCVModeItem->rightText = RIGHT_ARROW;
@@ -1,10 +1,28 @@
 #include "ZZC.hpp"
+#include "Groove.hpp"
 
 struct ZZC_TransportMessage {
   bool hasClock = false;
   float clockPhase = 0.f;
   bool clockReset = false;
   bool clockFlip = false;
+  float clockFlipOffset = 0.f; // in samples before this one, see Clock::clockEdgeOffset
+  bool clock8thsEdge = false;
+  float clock8thsEdgeOffset = 0.f;
+  bool clock16thsEdge = false;
+  float clock16thsEdgeOffset = 0.f;
+  // Predicted samples until the next edge of each output at the current tempo, -1 if stopped
+  float clockNextEdge = -1.f;
+  float clock8thsNextEdge = -1.f;
+  float clock16thsNextEdge = -1.f;
+  // Song position: whole beats since the last reset with clockPhase on top, and
+  // where that falls in the bar; beats of the bar count in clockBeatUnit notes
+  int64_t clockBeat = 0;
+  int64_t clockBar = 0;
+  int clockBeatInBar = 0;
+  float clockBarPhase = 0.f;
+  int clockBeatsPerBar = 4;
+  int clockBeatUnit = 4;
 
   bool hasDivider = false;
   float dividerPhase = 0.f;
@@ -63,6 +81,8 @@ struct Clock : Module {
     EXT_VBPS_MODE_LED,
     EXT_CLOCK_MODE_LED,
     EXT_PHASE_MODE_LED,
+    CLOCK_LOCK_GREEN_LED,
+    CLOCK_LOCK_RED_LED,
     NUM_LIGHTS
   };
   enum Modes {
@@ -76,9 +96,18 @@ struct Clock : Module {
 
   ClockTracker clockTracker;
   LowFrequencyOscillator oscillator;
+  ClockLanes lanes;
+  int laneChannels = 1; // of a polyphonic V/BPS input, each one a lane of its own
+  simd::float_4 laneBpm[4] = {0.f};
 
-  enum Modes mode;
-  enum Modes lastMode;
+  enum Modes mode = INTERNAL_MODE;
+  enum Modes lastMode = INTERNAL_MODE;
+
+  // Mode, panel controls, swing and lights only follow at control rate
+  dsp::ClockDivider controlDivider;
+  float vbpsVoltage = 0.0f;
+  float vbpsBpm = 120.0f;
+  bool vbpsBpmIsStale = true;
 
   float lastExtPhase = 0.0f;
 
@@ -89,9 +118,11 @@ struct Clock : Module {
   float swing8thsFinal = 50.0f;
   float swing16thsFinal = 50.0f;
 
-  float swinged8thsPhase = 0.5f;
-  float swinged16thsFirstPhase = 0.25f;
-  float swinged16thsSecondPhase = 0.75f;
+  GrooveTemplate grooveTemplate; // steps of the x4 output
+  GrooveEngine groove;
+  bool grooveIsStale = true;
+  float grooveSwing8ths = 50.0f; // the groove table was built for
+  float grooveSwing16ths = 50.0f;
 
   dsp::PulseGenerator clockPulseGenerator;
   dsp::PulseGenerator clock8thsPulseGenerator;
@@ -103,6 +134,25 @@ struct Clock : Module {
   bool clock16thsPulse = false;
   bool runPulse = false;
   bool resetPulse = false;
+
+  // Whether each clock output rose on this sample, and how many samples (0 to 1)
+  // before it the edge actually fell; offsets are held until the next edge
+  bool clockEdge = false;
+  bool clock8thsEdge = false;
+  bool clock16thsEdge = false;
+  float clockEdgeOffset = 0.0f;
+  float clock8thsEdgeOffset = 0.0f;
+  float clock16thsEdgeOffset = 0.0f;
+
+  // Predicted samples until the next edge of each output, -1 while none is coming
+  float clockNextEdge = -1.0f;
+  float clock8thsNextEdge = -1.0f;
+  float clock16thsNextEdge = -1.0f;
+  // Song position, negative when run in reverse past the last reset
+  int64_t beatCount = 0;
+  int64_t barCount = 0;
+  int beatInBar = 0;
+  float barPhase = 0.0f;
   bool resetWasHit = false;
   bool resetWasHitForMessage = false;
 
@@ -133,14 +183,29 @@ struct Clock : Module {
   bool useCompatibleBPMCV = true;
   bool snapCV = false;
   int externalClockPPQN = 1;
+  float clockTrackingBandwidth = 0.05f; // of the external clock loop, see ClockTracker
   float phaseOutputOffset = 0.0f;
+  bool edgeOffsetChannels = false; // adds the edge offsets as a second channel of the clock outputs
+  bool nextEdgeChannels = false; // adds the time to the next edges as channels 2-4 of the V/SPB output
+  int timeSignatureBeats = 4;
+  int timeSignatureUnit = 4; // 4, 8 or 16
+  bool barPhaseChannel = false; // adds the bar phase as channel 2 of the phase output
 
   Clock();
   void toggle();
+  void hitReset();
+  inline void processTransportInputs();
   inline void processButtons();
   inline void processSwingInputs();
-  inline void triggerThsByPhase(float phase, float lastPhase);
+  inline void followGroove(float phase, bool fire);
+  void setGrooveTemplate(const GrooveTemplate &groove);
+  inline void setEdges(bool base, bool x2, bool x4, float offset);
+  inline void processLanes(const ProcessArgs &args);
+  inline void predictEdges(const ProcessArgs &args);
+  inline void updateSongPosition(float phase);
   inline enum Modes detectMode();
+  inline void updateLights();
+  inline void fillMessage(ZZC_TransportMessage *message);
   void process(const ProcessArgs &args) override;
   json_t *dataToJson() override;
   void dataFromJson(json_t *rootJ) override;
@@ -0,0 +1,72 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/*
+ * The phase is a 64-bit fixed-point fraction of a cycle that wraps around by
+ * itself, so it advances by exactly the same step every sample and never
+ * drifts against the tempo, however long it runs and however slow it is.
+ * phase and lastPhase are derived from it for the outputs.
+ */
+struct FixedPointPhase {
+  uint64_t phaseAccumulator = 0;
+  float phase = 0.0f;
+  float lastPhase = 0.0f;
+  float flipOffset = 0.0f; // how far before this sample the phase wrapped, in samples
+  double freq = 1.0;
+  double freqCorrection = 0.0;
+  double incrementCycles = 0.0; // the increment below is for, converted only when it changes
+  int64_t increment = 0;
+
+  // In cycles per second, exact when given as e.g. bpm / 60.0
+  void setPitch(double pitch) {
+    freq = pitch;
+  }
+
+  void reset(float value) {
+    this->phaseAccumulator = phaseToAccumulator(value);
+    this->phase = this->accumulatorToPhase(this->phaseAccumulator);
+    this->freqCorrection = 0.0;
+  }
+
+  int64_t phaseIncrement(double dt) {
+    double cycles = (freq + this->freqCorrection) * dt;
+    if (cycles != this->incrementCycles) {
+      this->incrementCycles = cycles;
+      this->increment = cyclesToIncrement(cycles);
+    }
+    return this->increment;
+  }
+
+  static uint64_t phaseToAccumulator(float value) {
+    double wrapped = (double)value - std::floor((double)value);
+    return (uint64_t)std::ldexp(wrapped, 64);
+  }
+
+  // Cycles per sample, as a fraction of 2^64
+  static int64_t cyclesToIncrement(double deltaPhase) {
+    deltaPhase = std::max(-0.25, std::min(deltaPhase, 0.25));
+    return (int64_t)std::llround(std::ldexp(deltaPhase, 64));
+  }
+
+  // Top 24 bits only, so that the phase never rounds up to 1.0f
+  static float accumulatorToPhase(uint64_t accumulator) {
+    return (accumulator >> 40) * (1.0f / 16777216.0f);
+  }
+
+  // Takes the sample time as 1.0 / sampleRate, which a float would round
+  bool step(double dt) {
+    int64_t increment = this->phaseIncrement(dt);
+    uint64_t next = this->phaseAccumulator + (uint64_t)increment;
+    bool flipped = freq >= 0.0 ? increment > 0 && next < this->phaseAccumulator : increment < 0 && next > this->phaseAccumulator;
+    if (flipped) {
+      uint64_t past = increment > 0 ? next : (uint64_t)0 - next;
+      this->flipOffset = std::min((float)((double)past / std::abs((double)increment)), 1.0f);
+    }
+    this->phaseAccumulator = next;
+    this->lastPhase = this->phase;
+    this->phase = accumulatorToPhase(next);
+    return flipped;
+  }
+};
@@ -0,0 +1,166 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+/*
+ * How many steps a beat has and how far each one is pushed off the straight
+ * grid, in fractions of a step (positive is late). The first step always stays
+ * on the beat.
+ */
+struct GrooveTemplate {
+  static const int maxSteps = 16;
+
+  std::string name = "16ths";
+  int steps = 4;
+  float offsets[maxSteps] = {};
+
+  // Straight positions of the steps within the beat, steps + 1 of them ending at 1
+  void positions(float *result) const {
+    result[0] = 0.0f;
+    for (int i = 1; i < this->steps; i++) {
+      result[i] = (i + std::max(-0.49f, std::min(this->offsets[i], 0.49f))) / this->steps;
+    }
+    result[this->steps] = 1.0f;
+  }
+};
+
+/*
+ * Turns the beat phase into the edges of the x2 and x4 clocks. All of their
+ * rising and falling thresholds are laid out in one sorted table whenever the
+ * swing or the template changes, so that every sample only compares the phase
+ * to the next threshold in the direction it runs.
+ */
+struct GrooveEngine {
+  static const int maxEvents = 2 * (2 + GrooveTemplate::maxSteps);
+
+  enum Outputs {
+    X2_OUTPUT = 1,
+    X4_OUTPUT = 2
+  };
+
+  struct Event {
+    float phase;
+    uint8_t rises; // outputs rising here
+    uint8_t falls;
+    uint8_t gates; // outputs high from here up to the next event
+  };
+
+  Event events[maxEvents];
+  int count = 0;
+  int cursor = 0; // events at or before the position
+  float position = 0.0f;
+  // For each cursor, where each output rises next (1 for the beat) and where it rose last (0)
+  float riseAfter[maxEvents + 1][2];
+  float riseBefore[maxEvents + 1][2];
+
+  GrooveEngine() {
+    this->build(GrooveTemplate(), 0.5f, 0.5f);
+  }
+
+  // Swing moves the second 8th and the second 16th of each 8th, stretching everything in between
+  static float swingPhase(float straight, float swing8ths, float swing16ths) {
+    bool secondHalf = straight >= 0.5f;
+    float local = straight * 2.0f - (secondHalf ? 1.0f : 0.0f);
+    local = local < 0.5f ? local * 2.0f * swing16ths : swing16ths + (local - 0.5f) * 2.0f * (1.0f - swing16ths);
+    return secondHalf ? swing8ths + local * (1.0f - swing8ths) : local * swing8ths;
+  }
+
+  void build(const GrooveTemplate &groove, float swing8ths, float swing16ths) {
+    this->count = 0;
+    // x2 is always 8ths, falling at the 16ths in between
+    this->add(swingPhase(0.25f, swing8ths, swing16ths), 0, X2_OUTPUT);
+    this->add(swingPhase(0.5f, swing8ths, swing16ths), X2_OUTPUT, 0);
+    this->add(swingPhase(0.75f, swing8ths, swing16ths), 0, X2_OUTPUT);
+    float straight[GrooveTemplate::maxSteps + 1];
+    groove.positions(straight);
+    for (int i = 0; i < groove.steps; i++) {
+      if (i > 0) {
+        this->add(swingPhase(straight[i], swing8ths, swing16ths), X4_OUTPUT, 0);
+      }
+      this->add(swingPhase((straight[i] + straight[i + 1]) / 2.0f, swing8ths, swing16ths), 0, X4_OUTPUT);
+    }
+
+    std::sort(this->events, this->events + this->count, [](const Event &a, const Event &b) { return a.phase < b.phase; });
+    int merged = 0;
+    uint8_t gates = X2_OUTPUT | X4_OUTPUT;
+    for (int i = 0; i < this->count; i++) {
+      if (merged > 0 && this->events[merged - 1].phase == this->events[i].phase) {
+        this->events[merged - 1].rises |= this->events[i].rises;
+        this->events[merged - 1].falls |= this->events[i].falls;
+      } else {
+        this->events[merged++] = this->events[i];
+      }
+    }
+    this->count = merged;
+    for (int i = 0; i < this->count; i++) {
+      gates = (gates & ~this->events[i].falls) | this->events[i].rises;
+      this->events[i].gates = gates;
+    }
+
+    for (int output = 0; output < 2; output++) {
+      uint8_t mask = output == 0 ? X2_OUTPUT : X4_OUTPUT;
+      this->riseAfter[this->count][output] = 1.0f;
+      for (int i = this->count - 1; i >= 0; i--) {
+        this->riseAfter[i][output] = (this->events[i].rises & mask) ? this->events[i].phase : this->riseAfter[i + 1][output];
+      }
+      this->riseBefore[0][output] = 0.0f;
+      for (int i = 0; i < this->count; i++) {
+        this->riseBefore[i + 1][output] = (this->events[i].rises & mask) ? this->events[i].phase : this->riseBefore[i][output];
+      }
+    }
+    this->seek(this->position);
+  }
+
+  // Moves without firing anything
+  void seek(float phase) {
+    this->cursor = 0;
+    while (this->cursor < this->count && this->events[this->cursor].phase <= phase) {
+      this->cursor++;
+    }
+    this->position = phase;
+  }
+
+  // Calls onRise(event) for every event with outputs rising between the last position and
+  // this one; jumps of more than half a beat are taken for wraps and fire nothing
+  template <typename F>
+  void advance(float phase, F onRise) {
+    if (std::fabs(phase - this->position) > 0.5f) {
+      this->seek(phase);
+      return;
+    }
+    while (this->cursor < this->count && this->events[this->cursor].phase <= phase) {
+      if (this->events[this->cursor].rises) { onRise(this->events[this->cursor]); }
+      this->cursor++;
+    }
+    while (this->cursor > 0 && this->events[this->cursor - 1].phase > phase) {
+      this->cursor--;
+      if (this->events[this->cursor].rises) { onRise(this->events[this->cursor]); }
+    }
+    this->position = phase;
+  }
+
+  uint8_t gates() const {
+    return this->cursor == 0 ? (uint8_t)(X2_OUTPUT | X4_OUTPUT) : this->events[this->cursor - 1].gates;
+  }
+
+  // Where the output rises next in the direction of travel, the beat included
+  float nextRise(int output, bool forward) const {
+    return forward ? this->riseAfter[this->cursor][output] : this->riseBefore[this->cursor][output];
+  }
+
+  // Samples until the next beat, x2 and x4 rises if the tempo, in cycles per sample, holds
+  void predictRises(double phase, double cyclesPerSample, float *samples) const {
+    bool forward = cyclesPerSample > 0.0;
+    double speed = std::abs(cyclesPerSample);
+    samples[0] = (forward ? 1.0 - phase : phase) / speed;
+    samples[1] = std::abs(this->nextRise(0, forward) - phase) / speed;
+    samples[2] = std::abs(this->nextRise(1, forward) - phase) / speed;
+  }
+
+private:
+  void add(float phase, uint8_t rises, uint8_t falls) {
+    this->events[this->count++] = { phase, rises, falls, 0 };
+  }
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "dsp/Wavetable.hpp"
+
+/*
+ * Tables loaded from files stay around after the last player lets go of them,
+ * so that stepping back and forth through a folder does not parse them again.
+ * Whenever the storage of all tables together goes over the limit, the least
+ * recently used ones that no player holds any more are dropped. Tables in use
+ * are never evicted, so the usage may stay above the limit while they are.
+ */
+struct WavetableCache {
+  struct Entry {
+    std::string key;
+    std::shared_ptr<Wavetable> wt;
+  };
+
+  std::mutex mutex;
+  std::list<Entry> entries; // most recently used first
+  size_t limit = (size_t)256 << 20;
+
+  std::shared_ptr<Wavetable> find(const std::string &key) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (auto it = this->entries.begin(); it != this->entries.end(); it++) {
+      if (it->key == key) {
+        this->entries.splice(this->entries.begin(), this->entries, it);
+        return it->wt;
+      }
+    }
+    return nullptr;
+  }
+
+  void insert(const std::string &key, std::shared_ptr<Wavetable> wt) {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->entries.remove_if([&key](const Entry &entry) { return entry.key == key; });
+      this->entries.push_front({ key, wt });
+    }
+    this->trim();
+  }
+
+  void setLimit(size_t limit) {
+    this->limit = limit;
+    this->trim();
+  }
+
+  void trim() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (auto it = this->entries.end(); it != this->entries.begin() && WavetableStorageBytes() > this->limit;) {
+      it--;
+      // Only the cache holds it, no player will read it
+      if (it->wt.use_count() == 1) {
+        it = this->entries.erase(it);
+      }
+    }
+  }
+
+  size_t count() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->entries.size();
+  }
+};
@@ -2,6 +2,152 @@
 #include "ZZC.hpp"
 #include "WavetablePlayer.hpp"
 #include "filetypes/WavSupport.hpp"
+#include "dsp/WavetableCodec.hpp"
+#include "dsp/WavetableGenerator.hpp"
+#include "dsp/WavetableGrid.hpp"
+#include "filetypes/WavetableThumbnails.hpp"
+#include "WorkerPool.hpp"
+#include "WavetableCache.hpp"
+#include <set>
+
+/*
+ * Loads queued back to back (e.g. all players of a patch being opened) are
+ * timed together and reported once the last of them finishes.
+ */
+struct WavetableLoadBatch {
+  std::mutex mutex;
+  int pending = 0;
+  int loaded = 0;
+  double startedAt = 0.0;
+
+  void begin() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->pending == 0) {
+      this->loaded = 0;
+      this->startedAt = system::getTime();
+    }
+    this->pending++;
+  }
+
+  void end(bool success) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (success) {
+      this->loaded++;
+    }
+    if (--this->pending == 0) {
+      std::cout << "Loaded " << this->loaded << " wavetable(s) in "
+                << (system::getTime() - this->startedAt) * 1000.0 << " ms" << std::endl;
+    }
+  }
+};
+
+static WavetableLoadBatch loadBatch;
+static WavetableCache wavetableCache;
+
+/*
+ * The memory limit is shared by all players, so it is kept in the user
+ * folder rather than in patches.
+ */
+static std::string memorySettingsPath() {
+  return asset::user("ZZC-Wavetables.json");
+}
+
+static void loadMemorySettings() {
+  json_error_t error;
+  json_t *rootJ = json_load_file(memorySettingsPath().c_str(), 0, &error);
+  if (!rootJ) { return; }
+  json_t *limitJ = json_object_get(rootJ, "memoryLimitMB");
+  if (limitJ && json_integer_value(limitJ) > 0) {
+    wavetableCache.setLimit((size_t)json_integer_value(limitJ) << 20);
+  }
+  json_decref(rootJ);
+}
+
+static void saveMemorySettings() {
+  json_t *rootJ = json_object();
+  json_object_set_new(rootJ, "memoryLimitMB", json_integer(wavetableCache.limit >> 20));
+  json_dump_file(rootJ, memorySettingsPath().c_str(), JSON_INDENT(2));
+  json_decref(rootJ);
+}
+
+static std::once_flag memorySettingsLoaded;
+
+// Pool thread: interpolates extra frames into a freshly loaded table if asked to and makes it live
+static void publishWavetable(std::shared_ptr<WavetableHandoff> handoff, uint32_t generation, std::shared_ptr<Wavetable> source, int frames, bool half) {
+  std::shared_ptr<Wavetable> wt = source;
+  if (frames > source->n_tables && source->n_rows == 1 && !(source->flags & wtf_is_sample)) {
+    std::vector<HarmonicFrame> harmonics;
+    std::shared_ptr<Wavetable> upsampled = std::make_shared<Wavetable>();
+    if (interpolateFrames(source.get(), frames, harmonics) && generateWavetable(upsampled.get(), harmonics, source->size, false)) {
+      if (half) { upsampled->ConvertToHalf(); }
+      wt = upsampled;
+    }
+  }
+  handoff->publish(generation, source, wt, buildWavetablePreview(wt.get()));
+  wavetableCache.trim();
+}
+
+/*
+ * Pool thread: a table with quick preview mipmaps goes live as it is, while
+ * its levels get rebuilt with the full filter and swapped in behind it.
+ * Returns the table that stays live.
+ */
+static std::shared_ptr<Wavetable> publishProgressively(std::shared_ptr<WavetableHandoff> handoff, uint32_t generation, std::shared_ptr<Wavetable> wt, int frames, bool half) {
+  if (!wt->mipmaps_fast) {
+    if (half) { wt->ConvertToHalf(); }
+    publishWavetable(handoff, generation, wt, frames, half);
+    return wt;
+  }
+  // Short lived, so neither upsampled nor converted
+  handoff->publish(generation, wt, wt, buildWavetablePreview(wt.get()));
+  std::shared_ptr<Wavetable> refined = std::make_shared<Wavetable>();
+  if (generation != handoff->generation || !refined->CopyLevelZero(wt.get())) { return wt; }
+  refined->MipMapWT();
+  if (half) { refined->ConvertToHalf(); }
+  publishWavetable(handoff, generation, refined, frames, half);
+  return refined;
+}
+
+/*
+ * Folders opened in the browser menu get their thumbnails extracted on the
+ * worker pool; all players share them through a cache file in the user folder.
+ */
+struct WavetableBrowser {
+  WavetableThumbnailCache cache;
+  std::mutex mutex;
+  std::set<std::string> scanning;
+
+  std::vector<std::string> listFiles(std::string dir) {
+    std::vector<std::string> files;
+    for (std::string path : system::getEntries(dir)) {
+      if (isWavetableFilename(path) && system::isFile(path)) {
+        files.push_back(path);
+      }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+  }
+
+  void scan(std::string dir) {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      if (this->scanning.count(dir)) { return; }
+      this->scanning.insert(dir);
+    }
+    std::string cachePath = asset::user("ZZC-WavetableThumbnails.bin");
+    sharedWorkerPool().enqueue([this, dir, cachePath]() {
+      this->cache.load(cachePath);
+      for (std::string path : this->listFiles(dir)) {
+        this->cache.update(path);
+      }
+      this->cache.save();
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->scanning.erase(dir);
+    });
+  }
+};
+
+static WavetableBrowser browser;
 
 WavetablePlayer::WavetablePlayer() {
   this->wtPtr = std::make_shared<Wavetable>();
@@ -12,57 +158,99 @@ WavetablePlayer::WavetablePlayer() {
   // configParam(XTRA_PARAM, 0.f, 10.f, 5.0f, "Extrapolation");
   configParam(MIPMAP_PARAM, 0.f, 1.f, 1.0f, "MIP-mapping");
   configParam(INDEX_INTER_PARAM, 0.f, 1.f, 1.0f, "Index Interpolation");
+  configInput(INDEX_Y_INPUT, "Wave Index Y");
+  configInput(VOCT_INPUT, "V/OCT");
+  std::call_once(memorySettingsLoaded, loadMemorySettings);
 }
 
 json_t *WavetablePlayer::dataToJson() {
   json_t *rootJ = json_object();
   json_object_set_new(rootJ, "filename", json_string(filename.c_str()));
+  json_object_set_new(rootJ, "embedWavetable", json_boolean(embedWavetable));
+  json_object_set_new(rootJ, "oversampling", json_integer(oversampling));
+  json_object_set_new(rootJ, "frameUpsampling", json_integer(frameUpsampling));
+  json_object_set_new(rootJ, "slicePlainWav", json_boolean(slicePlainWav));
+  json_object_set_new(rootJ, "fastResampling", json_boolean(fastResampling));
+  json_object_set_new(rootJ, "halfStorage", json_boolean(halfStorage));
+  if (!this->gridFolder.empty()) {
+    json_object_set_new(rootJ, "gridFolder", json_string(this->gridFolder.c_str()));
+  }
+  if (!this->formula.empty()) {
+    json_object_set_new(rootJ, "formula", json_string(this->formula.c_str()));
+  } else if (this->embedWavetable && this->wtIsReady) {
+    std::shared_ptr<Wavetable> wt = std::atomic_load(&this->handoff->source);
+    if (this->embeddedDataSource.lock() != wt) {
+      std::vector<uint8_t> encoded;
+      this->embeddedData = encodeWavetable(wt.get(), encoded) ? string::toBase64(encoded) : "";
+      this->embeddedDataSource = wt;
+    }
+    if (!this->embeddedData.empty()) {
+      json_object_set_new(rootJ, "wavetableData", json_string(this->embeddedData.c_str()));
+    }
+  }
   return rootJ;
 }
 
 void WavetablePlayer::dataFromJson(json_t *rootJ) {
   json_t *filenameJ = json_object_get(rootJ, "filename");
-  if (filenameJ) {
+  json_t *embedWavetableJ = json_object_get(rootJ, "embedWavetable");
+  json_t *wavetableDataJ = json_object_get(rootJ, "wavetableData");
+  json_t *formulaJ = json_object_get(rootJ, "formula");
+  json_t *gridFolderJ = json_object_get(rootJ, "gridFolder");
+  json_t *oversamplingJ = json_object_get(rootJ, "oversampling");
+  json_t *frameUpsamplingJ = json_object_get(rootJ, "frameUpsampling");
+  json_t *slicePlainWavJ = json_object_get(rootJ, "slicePlainWav");
+  json_t *fastResamplingJ = json_object_get(rootJ, "fastResampling");
+  json_t *halfStorageJ = json_object_get(rootJ, "halfStorage");
+  if (embedWavetableJ) { embedWavetable = json_boolean_value(embedWavetableJ); }
+  if (slicePlainWavJ) { slicePlainWav = json_boolean_value(slicePlainWavJ); }
+  if (fastResamplingJ) { fastResampling = json_boolean_value(fastResamplingJ); }
+  if (halfStorageJ) { halfStorage = json_boolean_value(halfStorageJ); }
+  if (oversamplingJ) {
+    int factor = json_integer_value(oversamplingJ);
+    oversampling = (factor == 2 || factor == 4) ? factor : 1;
+  }
+  int previousFrameUpsampling = frameUpsampling;
+  if (frameUpsamplingJ) {
+    frameUpsampling = math::clamp((int)json_integer_value(frameUpsamplingJ), 0, max_subtables);
+  }
+  if (formulaJ) {
+    // Regenerating is cheaper than storing the samples
+    this->generateWT(json_string_value(formulaJ));
+  } else if (wavetableDataJ) {
+    // Embedded data wins, the file may not even exist on this machine
+    this->filename = filenameJ ? json_string_value(filenameJ) : "";
+    this->gridFolder = gridFolderJ ? json_string_value(gridFolderJ) : "";
+    this->loadEmbeddedWT(json_string_value(wavetableDataJ));
+  } else if (gridFolderJ) {
+    std::string newGridFolder = json_string_value(gridFolderJ);
+    if (newGridFolder != this->gridFolder) {
+      this->loadGridWT(newGridFolder);
+    }
+  } else if (filenameJ) {
     std::string newFilename = json_string_value(filenameJ);
     if (newFilename != this->filename) {
       this->tryToLoadWT(newFilename);
+    } else if (frameUpsampling != previousFrameUpsampling) {
+      this->setFrameUpsampling(frameUpsampling);
     }
   }
 }
 
-float getWTSample(Wavetable* wt, int wave, float phase) {
-  int targetWaveSize = wt->size;
-
-  float intpart;
-  float fractpart = std::modf(phase * targetWaveSize, &intpart);
-
-  int index0 = intpart;
-  int index1 = math::eucMod(index0 + 1, targetWaveSize);
-
-  int waveOffset = targetWaveSize * wave;
-
-  float sample0 = wt->TableF32Data[waveOffset + index0];
-  float sample1 = wt->TableF32Data[waveOffset + index1];
-
-  return math::crossfade(sample0, sample1, fractpart);
-}
-
-float getWTMipmapSample(Wavetable* wt, int mipmapLevel, int wave, float phase) {
-  int targetWaveSize = wt->size >> mipmapLevel;
-
-  float intpart;
-  float fractpart = std::modf(phase * targetWaveSize, &intpart);
-
-  int index0 = intpart;
-  int index1 = math::eucMod(index0 + 1, targetWaveSize);
-
-  float sample0 = wt->TableF32WeakPointers[mipmapLevel][wave][index0];
-  float sample1 = wt->TableF32WeakPointers[mipmapLevel][wave][index1];
-
-  return math::crossfade(sample0, sample1, fractpart);
-}
-
 void WavetablePlayer::process(const ProcessArgs &args) {
+  if (this->handoff->exchange(this->wtPtr, this->fadingWtPtr)) {
+    // Tables swapped under a playing voice (e.g. refined mipmaps) are crossfaded
+    if (this->wtIsReady) {
+      this->fadeReader = this->reader;
+      this->fadeLength = std::max(1, (int)(args.sampleRate * 0.005f));
+      this->fadeSamples = this->fadeLength;
+    }
+    this->wtIsReady = true;
+    this->reader.invalidate();
+  }
+  if (this->fadingWtPtr && this->fadeSamples == 0) {
+    this->handoff->release(this->fadingWtPtr);
+  }
   if (!this->wtIsReady) { return; }
 
   Wavetable* wt = this->wtPtr.get();
@@ -74,79 +262,254 @@ void WavetablePlayer::process(const ProcessArgs &args) {
     targetIndex = math::clamp(targetIndex + indexModulation, 0.f, 1.f);
   }
 
+  float indexY = math::clamp(this->inputs[INDEX_Y_INPUT].getVoltage() * 0.1f, 0.f, 1.f);
+  bool useMipmaps = this->params[MIPMAP_PARAM].getValue() > 0.f && wt->mipmaps_ready;
+  this->indexInter = this->params[INDEX_INTER_PARAM].getValue() > 0.f;
+  this->reader.indexInterpolation = this->indexInter;
+
+  float waveInterpolated;
+  float fadeWave = 0.f;
+  Wavetable *fadingWt = this->fadeSamples > 0 ? this->fadingWtPtr.get() : nullptr;
+  bool fadingMipmaps = fadingWt && useMipmaps && fadingWt->mipmaps_ready;
+  // The built-in oscillator only runs with V/OCT patched, so that unpatched players stay silent
+  if (this->inputs[PHASE_INPUT].isConnected() || !this->inputs[VOCT_INPUT].isConnected()) {
+    float phase = math::eucMod(this->inputs[PHASE_INPUT].getVoltage() * 0.1f, 1.f);
+    waveInterpolated = this->reader.process(wt, targetIndex, indexY, phase, useMipmaps, this->oversampling);
+    if (fadingWt) {
+      fadeWave = this->fadeReader.process(fadingWt, targetIndex, indexY, phase, fadingMipmaps, this->oversampling);
+    }
+  } else {
+    // Accumulated in double precision, so that low notes do not drift off pitch
+    double frequency = dsp::FREQ_C4 * dsp::approxExp2_taylor5(this->inputs[VOCT_INPUT].getVoltage() + 10.f) / 1024.f;
+    double phaseDelta = std::min(frequency * args.sampleTime, 0.5);
+    this->oscillatorPhase += phaseDelta;
+    this->oscillatorPhase -= std::floor(this->oscillatorPhase);
+    // Just below 1 rounds up to 1.f, which would read past the end of the frame
+    float phase = (float)this->oscillatorPhase;
+    if (phase >= 1.f) { phase -= 1.f; }
+    waveInterpolated = this->reader.process(wt, targetIndex, indexY, phase, (float)phaseDelta, useMipmaps, this->oversampling);
+    if (fadingWt) {
+      fadeWave = this->fadeReader.process(fadingWt, targetIndex, indexY, phase, (float)phaseDelta, fadingMipmaps, this->oversampling);
+    }
+  }
+  if (fadingWt) {
+    waveInterpolated += (fadeWave - waveInterpolated) * ((float)this->fadeSamples / this->fadeLength);
+    this->fadeSamples--;
+  }
+  this->indexIntpart = this->reader.indexIntpart;
+  this->interpolation = this->reader.interpolation;
 
-  float intpart;
-  float fractpart = std::modf(targetIndex * (wt->n_tables - 1), &intpart);
-
-  int index0 = intpart;
-  this->indexIntpart = index0;
-  int index1 = math::eucMod(index0 + 1, wt->n_tables);
-
-  // int mipmapLevel = std::min(wt->size_po2 - 2, (int)(this->level * 10));
-
-  float phase = math::eucMod(this->inputs[PHASE_INPUT].getVoltage() * 0.1f, 1.f);
-
-  // int targetMipmapLevel = this->inputs[MIPMAP_INPUT].isConnected() ? std::max(0, (int)std::floor(this->inputs[MIPMAP_INPUT].getVoltage())) : 0;
-
-  float junk;
-  float phaseDelta = std::modf((phase + 1.f) - lastPhase, &junk);
+  this->outputs[WAVE_OUTPUT].setVoltage(waveInterpolated * 5.f);
+  this->index = targetIndex;
+}
 
-  int targetMipmapLevel = -1;
-  float mipmapInterpol = 0.f;
+std::shared_ptr<Wavetable> WavetablePlayer::getWavetable() {
+  return std::atomic_load(&this->wtPtr);
+}
 
-  if (this->params[MIPMAP_PARAM].getValue() > 0.f) {
-    if (phaseDelta > 0.f) {
-      float samplesPerCycle = 1.f / phaseDelta;
-      float idealSizePo2 = std::log2f(samplesPerCycle);
-      float brightnessModifier = 0.0f;
-      float possibleSizePo2 = math::clamp(idealSizePo2 + brightnessModifier, 3.f, (float)wt->size_po2);
+std::shared_ptr<const WavetablePreview> WavetablePlayer::getPreview() {
+  return std::atomic_load(&this->handoff->preview);
+}
 
-      float referenceMipmapLevel = (float)wt->size_po2 - possibleSizePo2;
+// Only queues the load, the table goes live from a pool thread once built
+bool WavetablePlayer::tryToLoadWT(std::string path) {
+  if (!system::isFile(path)) { return false; }
+  this->filename = path;
+  this->formula = "";
+  this->gridFolder = "";
+  uint32_t generation = this->handoff->nextGeneration();
+  std::shared_ptr<WavetableHandoff> handoff = this->handoff;
+  int upsampling = this->frameUpsampling;
+  bool slice = this->slicePlainWav;
+  ResampleQuality quality = this->fastResampling ? RESAMPLE_FAST : RESAMPLE_HIGH;
+  bool half = this->halfStorage;
+  loadBatch.begin();
+  sharedWorkerPool().enqueue([handoff, generation, path, upsampling, slice, quality, half]() {
+    if (generation != handoff->generation) {
+      loadBatch.end(false);
+      return;
+    }
+    // The same file loads differently with other import settings, or once changed
+    uint64_t fileSize = 0;
+    int64_t modified = 0;
+    statWavetableFile(path, fileSize, modified);
+    std::string key = string::f("%s|%llu|%lld|%d|%d|%d", path.c_str(), (unsigned long long)fileSize, (long long)modified, slice, quality, half);
+    std::shared_ptr<Wavetable> wt = wavetableCache.find(key);
+    bool loaded = wt != nullptr;
+    if (!loaded) {
+      wt = std::make_shared<Wavetable>();
+      SurgeStorage ss;
+      ss.slicePlainWav = slice;
+      ss.resampleQuality = quality;
+      ss.fastMipmaps = true;
+      ss.progress = [handoff, generation](float progress) {
+        if (generation == handoff->generation) { handoff->progress = progress; }
+      };
+      loaded = ss.load_wt(path, wt.get());
+    }
+    if (loaded) {
+      wt = publishProgressively(handoff, generation, wt, upsampling, half);
+      // Superseded loads may stop at the preview, which is not worth keeping
+      if (!wt->mipmaps_fast) { wavetableCache.insert(key, wt); }
+    }
+    if (generation == handoff->generation) { handoff->progress = -1.f; }
+    loadBatch.end(loaded);
+  });
+  return true;
+}
 
-      float targetMipmapLevelFloat;
-      mipmapInterpol = std::modf(referenceMipmapLevel, &targetMipmapLevelFloat);
-      targetMipmapLevel = targetMipmapLevelFloat;
-      mipmapInterpol = mipmapInterpol * mipmapInterpol;
+void WavetablePlayer::loadEmbeddedWT(std::string data) {
+  this->formula = "";
+  uint32_t generation = this->handoff->nextGeneration();
+  std::shared_ptr<WavetableHandoff> handoff = this->handoff;
+  int upsampling = this->frameUpsampling;
+  bool half = this->halfStorage;
+  loadBatch.begin();
+  sharedWorkerPool().enqueue([handoff, generation, data, upsampling, half]() {
+    std::vector<uint8_t> bytes;
+    try {
+      bytes = string::fromBase64(data);
+    } catch (std::exception &e) {
+      std::cout << "Embedded wavetable is not valid base64" << std::endl;
+    }
+    std::shared_ptr<Wavetable> wt = std::make_shared<Wavetable>();
+    bool decoded = !bytes.empty() && decodeWavetable(bytes.data(), bytes.size(), wt.get(), false);
+    if (decoded) {
+      wt->MipMapWT(true);
+      publishProgressively(handoff, generation, wt, upsampling, half);
+    }
+    loadBatch.end(decoded);
+  });
+}
 
-      // targetMipmapLevel = wt->size_po2 - (int)nearestSizePo2Int;
+void WavetablePlayer::generateWT(std::string formula) {
+  this->formula = formula;
+  this->gridFolder = "";
+  uint32_t generation = this->handoff->nextGeneration();
+  std::shared_ptr<WavetableHandoff> handoff = this->handoff;
+  int upsampling = this->frameUpsampling;
+  bool half = this->halfStorage;
+  loadBatch.begin();
+  sharedWorkerPool().enqueue([handoff, generation, formula, upsampling, half]() {
+    if (generation != handoff->generation) {
+      loadBatch.end(false);
+      return;
+    }
+    const int size = 2048;
+    std::vector<HarmonicFrame> frames;
+    std::string error;
+    bool generated = buildHarmonicFrames(formula, 64, size / 2, frames, &error);
+    if (!generated) {
+      std::cout << "Wavetable formula error: " << error << std::endl;
+    }
+    std::shared_ptr<Wavetable> wt = std::make_shared<Wavetable>();
+    generated = generated && generateWavetable(wt.get(), frames, size);
+    if (generated) {
+      if (half) { wt->ConvertToHalf(); }
+      publishWavetable(handoff, generation, wt, upsampling, half);
+    }
+    loadBatch.end(generated);
+  });
+}
 
-      // if (this->debugDivider.process()) {
-      //   std::cout << targetMipmapLevel << std::endl;
-      // }
+// Every table in the folder becomes a row, in file name order
+void WavetablePlayer::loadGridWT(std::string dir) {
+  if (!system::isDirectory(dir)) { return; }
+  this->gridFolder = dir;
+  this->filename = "";
+  this->formula = "";
+  uint32_t generation = this->handoff->nextGeneration();
+  std::shared_ptr<WavetableHandoff> handoff = this->handoff;
+  bool slice = this->slicePlainWav;
+  ResampleQuality quality = this->fastResampling ? RESAMPLE_FAST : RESAMPLE_HIGH;
+  bool half = this->halfStorage;
+  loadBatch.begin();
+  sharedWorkerPool().enqueue([handoff, generation, dir, slice, quality, half]() {
+    std::vector<std::shared_ptr<Wavetable>> rows;
+    for (std::string path : browser.listFiles(dir)) {
+      if (generation != handoff->generation || (int)rows.size() == maxGridRows) { break; }
+      std::shared_ptr<Wavetable> row = std::make_shared<Wavetable>();
+      SurgeStorage ss;
+      ss.slicePlainWav = slice;
+      ss.resampleQuality = quality;
+      if (ss.load_wt(path, row.get())) {
+        rows.push_back(row);
+      }
     }
+    std::shared_ptr<Wavetable> wt = std::make_shared<Wavetable>();
+    bool built = generation == handoff->generation && buildWavetableGrid(rows, wt.get(), quality);
+    if (built) {
+      if (half) { wt->ConvertToHalf(); }
+      publishWavetable(handoff, generation, wt, 0, half);
+    } else if (rows.empty()) {
+      std::cout << "No wavetables found in " << dir << std::endl;
+    }
+    loadBatch.end(built);
+  });
+}
+
+void WavetablePlayer::selectGridFolder() {
+  std::string dir = asset::user("");
+  if (!this->gridFolder.empty()) {
+    dir = this->gridFolder;
+  } else if (!this->filename.empty()) {
+    dir = system::getDirectory(this->filename);
+  }
+  char *path = osdialog_file(OSDIALOG_OPEN_DIR, dir.c_str(), NULL, NULL);
+  if (path) {
+    this->loadGridWT(std::string(path));
   }
+  free(path);
+}
 
-  float wave0 = targetMipmapLevel >= 0 ? math::crossfade(
-    getWTMipmapSample(wt, targetMipmapLevel, index0, phase),
-    getWTMipmapSample(wt, targetMipmapLevel + 1, index0, phase),
-    mipmapInterpol
-  ) : getWTSample(wt, index0, phase);
-  float wave1 = targetMipmapLevel >= 0 ? math::crossfade(
-    getWTMipmapSample(wt, targetMipmapLevel, index1, phase),
-    getWTMipmapSample(wt, targetMipmapLevel + 1, index1, phase),
-    mipmapInterpol
-  ) : getWTSample(wt, index1, phase);
+// For import settings to apply to the current file
+void WavetablePlayer::reloadWT() {
+  if (!this->formula.empty()) { return; }
+  if (!this->gridFolder.empty()) {
+    this->loadGridWT(this->gridFolder);
+  } else if (!this->filename.empty()) {
+    this->tryToLoadWT(this->filename);
+  }
+}
 
-  float waveInterpolated = math::crossfade(wave0, wave1, fractpart);
-  this->interpolation = fractpart;
+void WavetablePlayer::setSlicePlainWav(bool slice) {
+  this->slicePlainWav = slice;
+  this->reloadWT();
+}
 
-  this->outputs[WAVE_OUTPUT].setVoltage(waveInterpolated * 5.f);
-  this->index = targetIndex;
+void WavetablePlayer::setFastResampling(bool fast) {
+  this->fastResampling = fast;
+  this->reloadWT();
+}
 
-  this->lastPhase = phase;
+// Rebuilds the playing table from the one it was loaded as
+void WavetablePlayer::setFrameUpsampling(int frames) {
+  this->frameUpsampling = frames;
+  std::shared_ptr<Wavetable> source = std::atomic_load(&this->handoff->source);
+  if (!source) { return; }
+  uint32_t generation = this->handoff->nextGeneration();
+  std::shared_ptr<WavetableHandoff> handoff = this->handoff;
+  bool half = this->halfStorage;
+  sharedWorkerPool().enqueue([handoff, generation, source, frames, half]() {
+    if (generation != handoff->generation) { return; }
+    publishWavetable(handoff, generation, source, frames, half);
+  });
 }
 
-bool WavetablePlayer::tryToLoadWT(std::string path) {
-  if (!system::isFile(path)) { return false; }
-  this->wtIsReady = false;
-  SurgeStorage* ss = new SurgeStorage();
-  bool loaded = ss->load_wt(path, this->wtPtr.get());
-  free(ss);
-  this->wtIsReady = true;
-  if (loaded) {
-    this->filename = path;
-  }
-  return loaded;
+void WavetablePlayer::setHalfStorage(bool half) {
+  this->halfStorage = half;
+  if (!this->formula.empty()) {
+    this->generateWT(this->formula);
+  } else if (!this->gridFolder.empty() || !this->filename.empty()) {
+    this->reloadWT();
+  } else {
+    // Embedded tables have nothing to be loaded again from but themselves
+    std::shared_ptr<Wavetable> source = std::atomic_load(&this->handoff->source);
+    std::vector<uint8_t> encoded;
+    if (source && encodeWavetable(source.get(), encoded)) {
+      this->loadEmbeddedWT(string::toBase64(encoded));
+    }
+  }
 }
 
 void WavetablePlayer::selectFile() {
@@ -196,6 +559,26 @@ struct WaveformDimensions {
   float skew;
 };
 
+void drawPreviewFrame(
+  const Widget::DrawArgs &args,
+  Vec pos, Vec size, float skew,
+  const float *points, int count
+) {
+  nvgBeginPath(args.vg);
+  nvgMoveTo(args.vg, pos.x, pos.y - points[0] * size.y);
+
+  for (int i = 1; i < count; i++) {
+    float phase = (float)i / (float)(count - 1);
+    nvgLineTo(args.vg, pos.x + phase * size.x, pos.y - points[i] * size.y + phase * skew);
+  }
+
+  nvgLineJoin(args.vg, NVG_ROUND);
+  nvgLineCap(args.vg, NVG_ROUND);
+  nvgMiterLimit(args.vg, 2.f);
+  nvgStrokeWidth(args.vg, 0.72f);
+  nvgStroke(args.vg);
+}
+
 void drawWave(
   const Widget::DrawArgs &args,
   Vec pos, Vec size, float skew,
@@ -225,9 +608,8 @@ void drawWave(
 }
 
 struct WavetableWidget : TransparentWidget {
-  std::shared_ptr<Wavetable> wtPtr;
+  WavetablePlayer *module = nullptr;
   float lineWidth = 0.72f;
-  int waveReso = 256;
   NVGcolor dimmedColor = nvgRGBA(0xfe, 0xc3, 0x00, 0x40);
   NVGcolor brightColor = nvgRGB(0xff, 0xd4, 0x2a);
   NVGcolor graphColor = nvgRGBA(0xfe, 0xc3, 0x00, 0x40);
@@ -236,18 +618,26 @@ struct WavetableWidget : TransparentWidget {
 
   void draw(const DrawArgs &args) override {
 
-    if (!this->wtPtr) { return; }
+    if (!this->module) { return; }
 
     std::shared_ptr<Font> font = APP->window->loadFont(asset::plugin(pluginInstance, "res/fonts/SKODANext/SKODANext-Regular.ttf"));
     if (!font) { return; }
 
-    Wavetable* wt = this->wtPtr.get();
-
-    nvgStrokeColor(args.vg, this->graphColor);
-
-    for (int waveIdx = 0; waveIdx < wt->n_tables; waveIdx++) {
-      Vec pos = this->wd.pos.plus(this->wd.depth.mult((float)waveIdx / (float)(wt->n_tables - 1)));
-      drawWave(args, pos, this->wd.waveSize, this->wd.skew, this->waveReso, wt->size, wt->TableF32Data + waveIdx * wt->size, false);
+    std::shared_ptr<const WavetablePreview> preview = this->module->getPreview();
+    int size = 0;
+    int tables = 0;
+    int rows = 1;
+
+    if (preview) {
+      size = preview->size;
+      tables = preview->tables;
+      rows = preview->rows;
+      nvgStrokeColor(args.vg, this->graphColor);
+      for (int idx = 0; idx < (int)preview->frames.size(); idx++) {
+        float depth = tables > 1 ? (float)preview->frames[idx] / (float)(tables - 1) : 0.f;
+        Vec pos = this->wd.pos.plus(this->wd.depth.mult(depth));
+        drawPreviewFrame(args, pos, this->wd.waveSize, this->wd.skew, preview->framePoints(idx), preview->pointsPerFrame());
+      }
     }
 
     nvgFontSize(args.vg, 8.5f);
@@ -256,7 +646,8 @@ struct WavetableWidget : TransparentWidget {
     nvgTextAlign(args.vg, NVG_ALIGN_CENTER);
     Vec textPos = Vec(box.size.x / 2.f, box.size.y * 0.13f);
     nvgFillColor(args.vg, dimmedColor);
-    nvgText(args.vg, textPos.x, textPos.y, string::f("%d x %d", wt->size, wt->n_tables).c_str(), nullptr);
+    std::string dimensions = rows > 1 ? string::f("%d x %d x %d", size, tables / rows, rows) : string::f("%d x %d", size, tables);
+    nvgText(args.vg, textPos.x, textPos.y, dimensions.c_str(), nullptr);
 
     textPos = Vec(box.size.x / 2.f, box.size.y * 0.89f);
     nvgFillColor(args.vg, brightColor);
@@ -265,7 +656,14 @@ struct WavetableWidget : TransparentWidget {
     std::string finalFilename = fullFilename;
 
     size_t maxLength = 16;
-    if (fullFilename.length() > maxLength) {
+    float progress = this->module->handoff->progress;
+    if (progress >= 0.f) {
+      finalFilename = string::f("Slicing %d%%", (int)(progress * 100.f));
+    } else if (!this->module->formula.empty()) {
+      finalFilename = string::ellipsize(this->module->formula, maxLength);
+    } else if (!this->module->gridFolder.empty()) {
+      finalFilename = string::ellipsize(system::getFilename(this->module->gridFolder), maxLength);
+    } else if (fullFilename.length() > maxLength) {
       if (fullFilename.find('-') != std::string::npos) {
         // Has delimiter, let's split first part
         finalFilename = string::ellipsize(
@@ -288,24 +686,38 @@ struct WavetableWidget : TransparentWidget {
 };
 
 struct WaveformWidget : TransparentWidget {
-  std::shared_ptr<Wavetable> wtPtr;
+  WavetablePlayer *module = nullptr;
   float* index = nullptr;
   int* indexIntpart = nullptr;
   float* interpolation = nullptr;
   bool* inter = nullptr;
   int waveReso = 256;
+  std::vector<float> widened;
   WaveformDimensions wd;
   NVGcolor graphColor = nvgRGB(0xff, 0xd4, 0x2a);
 
   void draw(const DrawArgs &args) override {
-    if (!this->wtPtr) { return; }
+    if (!this->module) { return; }
 
-    Wavetable* wt = this->wtPtr.get();
+    std::shared_ptr<Wavetable> wtPtr = this->module->getWavetable();
+    Wavetable* wt = wtPtr.get();
 
     nvgStrokeColor(args.vg, this->graphColor);
 
+    int frame = *this->indexIntpart;
+    float *data;
+    if (wt->TableF16Data) {
+      // Half float tables get the two frames drawn widened first
+      this->widened.resize(2 * wt->size);
+      wt->ReadFrame(0, frame, this->widened.data());
+      wt->ReadFrame(0, std::min(frame + 1, wt->n_tables - 1), this->widened.data() + wt->size);
+      data = this->widened.data();
+    } else {
+      data = wt->TableF32Data + frame * wt->size;
+    }
+
     Vec pos = this->wd.pos.plus(this->wd.depth.mult(*this->index));
-    drawWave(args, pos, this->wd.waveSize, this->wd.skew, this->waveReso, wt->size, wt->TableF32Data + *this->indexIntpart * wt->size, true, *this->interpolation);
+    drawWave(args, pos, this->wd.waveSize, this->wd.skew, this->waveReso, wt->size, data, true, *this->interpolation);
   }
 };
 
@@ -355,7 +767,7 @@ struct WavetableNextButtonWidget : SvgButton {
 };
 
 struct WavetableDisplayWidget : Widget {
-  std::shared_ptr<Wavetable> wtPtr;
+  WavetablePlayer *module = nullptr;
   NVGcolor monoColor = nvgRGB(0xff, 0xd4, 0x2a);
   NVGcolor polyColor = nvgRGB(0x29, 0xb2, 0xef);
 
@@ -366,6 +778,8 @@ struct WavetableDisplayWidget : Widget {
   WavetableOpenButtonWidget *obw;
   WavetablePrevButtonWidget *pbw;
   WavetableNextButtonWidget *nbw;
+  std::shared_ptr<const WavetablePreview> shownPreview;
+  int shownProgress = -100;
 
   WavetableDisplayWidget() {
     this->fbw = new widget::FramebufferWidget;
@@ -390,7 +804,6 @@ struct WavetableDisplayWidget : Widget {
   NVGcolor calcColor(float step, float lineWidth) {
     float potentialOverlap = std::max(0.f, lineWidth * 1.5f - step);
     float alphaMultiplier = std::max(0.05f, 1.f - potentialOverlap);
-    std::cout << "alphaMultiplier: " << alphaMultiplier << std::endl;
     return nvgRGBA(
       0xfe, 0xc3, 0x00,
       (int)((float)0x40 * alphaMultiplier)
@@ -430,12 +843,20 @@ struct WavetableDisplayWidget : Widget {
   }
 
   void step() override {
-    if (this->wtPtr) {
-      Wavetable* wt = this->wtPtr.get();
-      if (wt->refresh_display) {
-        wt->refresh_display = false;
-        float verticalStep = (-this->wd.depth.y) / (wt->n_tables - 1);
-        this->wtw->graphColor = calcColor(verticalStep, this->wtw->lineWidth);
+    if (this->module) {
+      std::shared_ptr<const WavetablePreview> preview = this->module->getPreview();
+      if (preview != this->shownPreview) {
+        this->shownPreview = preview;
+        int drawnFrames = preview ? (int)preview->frames.size() : 0;
+        if (drawnFrames > 1) {
+          float verticalStep = (-this->wd.depth.y) / (drawnFrames - 1);
+          this->wtw->graphColor = calcColor(verticalStep, this->wtw->lineWidth);
+        }
+        this->fbw->dirty = true;
+      }
+      int progress = (int)(this->module->handoff->progress * 100.f);
+      if (progress != this->shownProgress) {
+        this->shownProgress = progress;
         this->fbw->dirty = true;
       }
     }
@@ -457,12 +878,12 @@ WavetablePlayerWidget::WavetablePlayerWidget(WavetablePlayer *module) {
   display->box.size = Vec(this->box.size.x, this->box.size.x);
   display->setupSizes();
   if (module) {
-    display->wtPtr = module->wtPtr;
+    display->module = module;
 
-    display->wtw->wtPtr = module->wtPtr;
+    display->wtw->module = module;
     display->wtw->filename = &module->filename;
 
-    display->wfw->wtPtr = module->wtPtr;
+    display->wfw->module = module;
     display->wfw->index = &module->index;
     display->wfw->indexIntpart = &module->indexIntpart;
     display->wfw->interpolation = &module->interpolation;
@@ -483,7 +904,8 @@ WavetablePlayerWidget::WavetablePlayerWidget(WavetablePlayer *module) {
 
   addInput(createInput<ZZC_PJ_Port>(Vec(11.914f, 275.f), module, WavetablePlayer::PHASE_INPUT));
   addInput(createInput<ZZC_PJ_Port>(Vec(47.5f, 275.f), module, WavetablePlayer::INDEX_CV_INPUT));
-  // addOutput(createOutput<ZZC_PJ_Port>(Vec(11.914f, 320.f), module, WavetablePlayer::INTER_OUTPUT));
+  addInput(createInput<ZZC_PJ_Port>(Vec(83.084f, 275.f), module, WavetablePlayer::INDEX_Y_INPUT));
+  addInput(createInput<ZZC_PJ_Port>(Vec(11.914f, 320.f), module, WavetablePlayer::VOCT_INPUT));
   addOutput(createOutput<ZZC_PJ_Port>(Vec(47.5f, 320.f), module, WavetablePlayer::WAVE_OUTPUT));
   // addOutput(createOutput<ZZC_PJ_Port>(Vec(83.086f, 320.f), module, WavetablePlayer::XTRA_OUTPUT));
 
@@ -500,6 +922,254 @@ struct SelectFolderItem : MenuItem {
   }
 };
 
+struct SelectGridFolderItem : MenuItem {
+  WavetablePlayer *module;
+  void onAction(const event::Action &e) override {
+    module->selectGridFolder();
+  }
+};
+
+struct WavetableBrowserItem : MenuItem {
+  WavetablePlayer *module;
+  std::string path;
+  std::shared_ptr<const WavetablePreview> thumbnail;
+  float thumbnailWidth = 36.f;
+
+  void onAction(const event::Action &e) override {
+    module->tryToLoadWT(path);
+  }
+
+  void step() override {
+    if (!this->thumbnail) {
+      this->thumbnail = browser.cache.find(this->path);
+    }
+    rightText = CHECKMARK(module->formula.empty() && module->filename == path);
+    MenuItem::step();
+    box.size.x += this->thumbnailWidth + 8.f;
+  }
+
+  void draw(const DrawArgs &args) override {
+    MenuItem::draw(args);
+    if (!this->thumbnail || this->thumbnail->frames.empty()) { return; }
+
+    int frames = this->thumbnail->frames.size();
+    Vec depth(6.f, -6.f);
+    Vec waveSize(this->thumbnailWidth - depth.x, 3.f);
+    Vec origin(box.size.x - 20.f - this->thumbnailWidth, box.size.y * 0.5f - depth.y * 0.5f);
+    nvgStrokeColor(args.vg, nvgRGBA(0xfe, 0xc3, 0x00, 0xa0));
+    for (int idx = 0; idx < frames; idx++) {
+      Vec pos = origin.plus(depth.mult(frames > 1 ? (float)idx / (float)(frames - 1) : 0.f));
+      drawPreviewFrame(args, pos, waveSize, 0.f, this->thumbnail->framePoints(idx), this->thumbnail->pointsPerFrame());
+    }
+  }
+};
+
+struct WavetableBrowserMenuItem : MenuItem {
+  WavetablePlayer *module;
+  Menu *createChildMenu() override {
+    Menu *menu = new Menu;
+
+    std::string dir = module->filename != "" ? system::getDirectory(module->filename) : asset::user("");
+    browser.scan(dir);
+    std::vector<std::string> files = browser.listFiles(dir);
+
+    if (files.empty()) {
+      menu->addChild(createMenuLabel("No wavetables in this folder"));
+    }
+    for (std::string path : files) {
+      WavetableBrowserItem *item = new WavetableBrowserItem;
+      item->text = system::getFilename(path);
+      item->path = path;
+      item->module = module;
+      menu->addChild(item);
+    }
+    return menu;
+  }
+};
+
+struct WavetableFormulaField : ui::TextField {
+  WavetablePlayer *module;
+  void onSelectKey(const event::SelectKey &e) override {
+    if (e.action == GLFW_PRESS && (e.key == GLFW_KEY_ENTER || e.key == GLFW_KEY_KP_ENTER)) {
+      module->generateWT(this->text);
+      ui::MenuOverlay *overlay = getAncestorOfType<ui::MenuOverlay>();
+      if (overlay) { overlay->requestDelete(); }
+      e.consume(this);
+      return;
+    }
+    ui::TextField::onSelectKey(e);
+  }
+};
+
+struct WavetableFormulaPresetItem : MenuItem {
+  WavetablePlayer *module;
+  std::string formula;
+  void onAction(const event::Action &e) override {
+    module->generateWT(formula);
+  }
+  void step() override {
+    rightText = CHECKMARK(module->formula == formula);
+    MenuItem::step();
+  }
+};
+
+struct WavetableGeneratorMenuItem : MenuItem {
+  WavetablePlayer *module;
+  Menu *createChildMenu() override {
+    Menu *menu = new Menu;
+
+    menu->addChild(createMenuLabel("Harmonic amplitude [; phase] of n, t, f"));
+    WavetableFormulaField *field = new WavetableFormulaField;
+    field->module = module;
+    field->box.size.x = 220.f;
+    field->placeholder = "(1 - t * (1 - n % 2)) / n";
+    field->text = module->formula;
+    menu->addChild(field);
+
+    menu->addChild(new MenuSeparator());
+
+    std::vector<std::pair<std::string, std::string>> presets = {
+      { "Saw to Square", "(1 - t * (1 - n % 2)) / n" },
+      { "Sine to Saw", "exp(-(n - 1) * (1 - t) * 4) / n" },
+      { "Pulse Width Sweep", "sin(pi * n * (0.05 + 0.45 * t)) / n" },
+      { "Formant Sweep", "exp(-((n - 2 - 30 * t) ^ 2) / 8)" },
+      { "Phase Spread", "1 / n; n * n * t" },
+    };
+    for (std::pair<std::string, std::string> preset : presets) {
+      WavetableFormulaPresetItem *item = new WavetableFormulaPresetItem;
+      item->text = preset.first;
+      item->formula = preset.second;
+      item->module = module;
+      menu->addChild(item);
+    }
+    return menu;
+  }
+};
+
+struct OversamplingValueItem : MenuItem {
+  WavetablePlayer *module;
+  int factor;
+  void onAction(const event::Action &e) override {
+    module->oversampling = factor;
+  }
+};
+
+struct OversamplingItem : MenuItem {
+  WavetablePlayer *module;
+  Menu *createChildMenu() override {
+    Menu *menu = new Menu;
+
+    int factors[] = { 1, 2, 4 };
+    for (int factor : factors) {
+      OversamplingValueItem *oversamplingValueItem = new OversamplingValueItem;
+      oversamplingValueItem->text = factor == 1 ? "Off" : string::f("%dx", factor);
+      oversamplingValueItem->rightText = CHECKMARK(module->oversampling == factor);
+      oversamplingValueItem->module = module;
+      oversamplingValueItem->factor = factor;
+      menu->addChild(oversamplingValueItem);
+    }
+
+    return menu;
+  }
+};
+
+struct EmbedWavetableItem : MenuItem {
+  WavetablePlayer *module;
+  void onAction(const event::Action &e) override {
+    module->embedWavetable ^= true;
+  }
+  void step() override {
+    rightText = CHECKMARK(module->embedWavetable);
+  }
+};
+
+struct SlicePlainWavItem : MenuItem {
+  WavetablePlayer *module;
+  void onAction(const event::Action &e) override {
+    module->setSlicePlainWav(!module->slicePlainWav);
+  }
+  void step() override {
+    rightText = CHECKMARK(module->slicePlainWav);
+  }
+};
+
+struct FastResamplingItem : MenuItem {
+  WavetablePlayer *module;
+  void onAction(const event::Action &e) override {
+    module->setFastResampling(!module->fastResampling);
+  }
+  void step() override {
+    rightText = CHECKMARK(module->fastResampling);
+  }
+};
+
+struct HalfStorageItem : MenuItem {
+  WavetablePlayer *module;
+  void onAction(const event::Action &e) override {
+    module->setHalfStorage(!module->halfStorage);
+  }
+  void step() override {
+    rightText = CHECKMARK(module->halfStorage);
+  }
+};
+
+struct MemoryLimitValueItem : MenuItem {
+  int megabytes;
+  void onAction(const event::Action &e) override {
+    wavetableCache.setLimit((size_t)megabytes << 20);
+    saveMemorySettings();
+  }
+};
+
+struct MemoryLimitItem : MenuItem {
+  Menu *createChildMenu() override {
+    Menu *menu = new Menu;
+
+    menu->addChild(construct<MenuLabel>(&MenuLabel::text, string::f(
+      "%.1f MB in use, %d unused table(s) cached",
+      WavetableStorageBytes() / 1048576.0, (int)wavetableCache.count()
+    )));
+    menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Limit"));
+    int limits[] = { 64, 128, 256, 512, 1024, 2048 };
+    for (int megabytes : limits) {
+      MemoryLimitValueItem *memoryLimitValueItem = new MemoryLimitValueItem;
+      memoryLimitValueItem->text = string::f("%d MB", megabytes);
+      memoryLimitValueItem->rightText = CHECKMARK(wavetableCache.limit == (size_t)megabytes << 20);
+      memoryLimitValueItem->megabytes = megabytes;
+      menu->addChild(memoryLimitValueItem);
+    }
+
+    return menu;
+  }
+};
+
+struct FrameUpsamplingValueItem : MenuItem {
+  WavetablePlayer *module;
+  int frames;
+  void onAction(const event::Action &e) override {
+    module->setFrameUpsampling(frames);
+  }
+};
+
+struct FrameUpsamplingItem : MenuItem {
+  WavetablePlayer *module;
+  Menu *createChildMenu() override {
+    Menu *menu = new Menu;
+
+    int framesCounts[] = { 0, 64, 256 };
+    for (int frames : framesCounts) {
+      FrameUpsamplingValueItem *frameUpsamplingValueItem = new FrameUpsamplingValueItem;
+      frameUpsamplingValueItem->text = frames == 0 ? "Off" : string::f("%d frames", frames);
+      frameUpsamplingValueItem->rightText = CHECKMARK(module->frameUpsampling == frames);
+      frameUpsamplingValueItem->module = module;
+      frameUpsamplingValueItem->frames = frames;
+      menu->addChild(frameUpsamplingValueItem);
+    }
+
+    return menu;
+  }
+};
+
 void WavetablePlayerWidget::appendContextMenu(Menu *menu) {
 
   WavetablePlayer *wavetablePlayer = dynamic_cast<WavetablePlayer*>(module);
@@ -511,6 +1181,56 @@ void WavetablePlayerWidget::appendContextMenu(Menu *menu) {
   selectFolderItem->text = "Select Wavetables Folder...";
   selectFolderItem->module = wavetablePlayer;
   menu->addChild(selectFolderItem);
+
+  SelectGridFolderItem *selectGridFolderItem = new SelectGridFolderItem;
+  selectGridFolderItem->text = "Load Folder as Grid...";
+  selectGridFolderItem->module = wavetablePlayer;
+  menu->addChild(selectGridFolderItem);
+
+  WavetableBrowserMenuItem *browserMenuItem = new WavetableBrowserMenuItem;
+  browserMenuItem->text = "Browse Folder";
+  browserMenuItem->rightText = RIGHT_ARROW;
+  browserMenuItem->module = wavetablePlayer;
+  menu->addChild(browserMenuItem);
+
+  WavetableGeneratorMenuItem *generatorMenuItem = new WavetableGeneratorMenuItem;
+  generatorMenuItem->text = "Generate";
+  generatorMenuItem->rightText = RIGHT_ARROW;
+  generatorMenuItem->module = wavetablePlayer;
+  menu->addChild(generatorMenuItem);
+
+  OversamplingItem *oversamplingItem = new OversamplingItem;
+  oversamplingItem->text = "Oversampling";
+  oversamplingItem->rightText = RIGHT_ARROW;
+  oversamplingItem->module = wavetablePlayer;
+  menu->addChild(oversamplingItem);
+
+  FrameUpsamplingItem *frameUpsamplingItem = new FrameUpsamplingItem;
+  frameUpsamplingItem->text = "Intermediate Frames";
+  frameUpsamplingItem->rightText = RIGHT_ARROW;
+  frameUpsamplingItem->module = wavetablePlayer;
+  menu->addChild(frameUpsamplingItem);
+
+  SlicePlainWavItem *slicePlainWavItem = createMenuItem<SlicePlainWavItem>("Slice Plain WAVs by Pitch");
+  slicePlainWavItem->module = wavetablePlayer;
+  menu->addChild(slicePlainWavItem);
+
+  FastResamplingItem *fastResamplingItem = createMenuItem<FastResamplingItem>("Fast Resampling of Odd Frame Sizes");
+  fastResamplingItem->module = wavetablePlayer;
+  menu->addChild(fastResamplingItem);
+
+  HalfStorageItem *halfStorageItem = createMenuItem<HalfStorageItem>("Half-Precision Table Storage");
+  halfStorageItem->module = wavetablePlayer;
+  menu->addChild(halfStorageItem);
+
+  MemoryLimitItem *memoryLimitItem = new MemoryLimitItem;
+  memoryLimitItem->text = "Wavetable Memory";
+  memoryLimitItem->rightText = string::f("%.0f MB ", WavetableStorageBytes() / 1048576.0) + RIGHT_ARROW;
+  menu->addChild(memoryLimitItem);
+
+  EmbedWavetableItem *embedWavetableItem = createMenuItem<EmbedWavetableItem>("Embed Wavetable in Patch");
+  embedWavetableItem->module = wavetablePlayer;
+  menu->addChild(embedWavetableItem);
 }
 
 Model *modelWavetablePlayer = createModel<WavetablePlayer, WavetablePlayerWidget>("WavetablePlayer");
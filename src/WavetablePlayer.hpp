@@ -1,5 +1,70 @@
 #include "ZZC.hpp"
 #include "dsp/Wavetable.hpp"
+#include "dsp/WavetablePreview.hpp"
+#include "dsp/WavetableRead.hpp"
+#include <atomic>
+#include <mutex>
+
+/*
+ * Tables are always built off the audio thread into a fresh Wavetable and
+ * handed over here; the player swaps them in at the start of process().
+ */
+struct WavetableHandoff {
+  std::mutex mutex;
+  std::atomic<bool> hasPending { false };
+  std::atomic<uint32_t> generation { 0 };
+  std::atomic<float> progress { -1.f }; // of the current load when it reports any, -1 otherwise
+  std::shared_ptr<Wavetable> pending;
+  std::shared_ptr<Wavetable> retired[2]; // tables the player let go of, freed by the next publish()
+  std::shared_ptr<Wavetable> source; // as loaded, before frame upsampling; accessed atomically
+  std::shared_ptr<const WavetablePreview> preview; // UI only, accessed atomically
+
+  uint32_t nextGeneration() {
+    return ++this->generation;
+  }
+
+  // Results of superseded loads are dropped
+  void publish(uint32_t forGeneration, std::shared_ptr<Wavetable> source, std::shared_ptr<Wavetable> wt, std::shared_ptr<const WavetablePreview> preview) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (forGeneration != this->generation) { return; }
+    this->retired[0].reset();
+    this->retired[1].reset();
+    this->pending = wt;
+    this->hasPending = true;
+    std::atomic_store(&this->source, source);
+    std::atomic_store(&this->preview, preview);
+  }
+
+  // Audio thread: never blocks. The replaced table is handed back in previous for
+  // the player to fade out and release(); one it was still fading is parked here.
+  bool exchange(std::shared_ptr<Wavetable> &current, std::shared_ptr<Wavetable> &previous) {
+    if (!this->hasPending) { return false; }
+    std::unique_lock<std::mutex> lock(this->mutex, std::try_to_lock);
+    if (!lock.owns_lock()) { return false; }
+    if (previous && !this->retire(previous)) { return false; }
+    previous = std::atomic_exchange(&current, this->pending);
+    this->pending.reset();
+    this->hasPending = false;
+    return true;
+  }
+
+  // Audio thread: parks a table the player is done with, false to try again later
+  bool release(std::shared_ptr<Wavetable> &table) {
+    std::unique_lock<std::mutex> lock(this->mutex, std::try_to_lock);
+    return lock.owns_lock() && this->retire(table);
+  }
+
+private:
+  bool retire(std::shared_ptr<Wavetable> &table) {
+    for (std::shared_ptr<Wavetable> &slot : this->retired) {
+      if (!slot) {
+        slot = std::move(table);
+        return true;
+      }
+    }
+    return false;
+  }
+};
 
 struct WavetablePlayer : Module {
   enum ParamIds {
@@ -13,6 +78,8 @@ struct WavetablePlayer : Module {
   enum InputIds {
     PHASE_INPUT,
     INDEX_CV_INPUT,
+    INDEX_Y_INPUT,
+    VOCT_INPUT,
     NUM_INPUTS
   };
   enum OutputIds {
@@ -26,6 +93,7 @@ struct WavetablePlayer : Module {
   };
 
   std::shared_ptr<Wavetable> wtPtr = std::shared_ptr<Wavetable>(nullptr);
+  std::shared_ptr<WavetableHandoff> handoff = std::make_shared<WavetableHandoff>();
   float wave = 0.f;
   float level = 0.f;
   int lastMipmapLevel = 0;
@@ -36,10 +104,28 @@ struct WavetablePlayer : Module {
   float interpolation = 0.f;
   bool indexInter = true;
 
-  float lastPhase = 0.f;
+  WavetableReader reader;
+  std::shared_ptr<Wavetable> fadingWtPtr; // the table replaced last, faded out over fadeLength samples
+  WavetableReader fadeReader;
+  int fadeSamples = 0;
+  int fadeLength = 1;
+  double oscillatorPhase = 0.0; // of the built-in oscillator, used while only VOCT_INPUT is connected
   dsp::ClockDivider debugDivider;
 
   std::string filename;
+  std::string formula; // set instead of filename for generated tables
+  std::string gridFolder; // set instead of filename for grids built from a folder
+
+  /* Settings */
+  bool embedWavetable = false;
+  int oversampling = 1;
+  int frameUpsampling = 0; // frames count to interpolate tables with fewer frames to, 0 is off
+  bool slicePlainWav = false;
+  bool fastResampling = false; // for frames that are not a power of two long
+  bool halfStorage = false; // keeps loaded tables as half floats
+
+  std::string embeddedData;
+  std::weak_ptr<Wavetable> embeddedDataSource;
 
   WavetablePlayer();
   void process(const ProcessArgs &args) override;
@@ -49,4 +135,15 @@ struct WavetablePlayer : Module {
   void selectFile();
   void switchFile(int delta);
   bool tryToLoadWT(std::string path);
+  void loadEmbeddedWT(std::string data);
+  void generateWT(std::string formula);
+  void selectGridFolder();
+  void loadGridWT(std::string dir);
+  void setFrameUpsampling(int frames);
+  void setSlicePlainWav(bool slice);
+  void setFastResampling(bool fast);
+  void setHalfStorage(bool half);
+  void reloadWT();
+  std::shared_ptr<Wavetable> getWavetable();
+  std::shared_ptr<const WavetablePreview> getPreview();
 };
@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed set of background threads shared by all modules of the plugin for
+ * slow non-realtime work such as parsing and mipmapping wavetables.
+ */
+struct WorkerPool {
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::condition_variable drained;
+  std::deque<std::function<void()>> jobs;
+  std::vector<std::thread> threads;
+  int running = 0;
+  bool stopping = false;
+
+  WorkerPool(int threadsCount) {
+    for (int i = 0; i < threadsCount; i++) {
+      this->threads.emplace_back([this]() { this->work(); });
+    }
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->stopping = true;
+      this->jobs.clear();
+    }
+    this->wakeUp.notify_all();
+    for (std::thread &thread : this->threads) {
+      thread.join();
+    }
+  }
+
+  static int defaultThreadsCount() {
+    int cores = (int)std::thread::hardware_concurrency();
+    return std::max(1, std::min(cores - 1, 8));
+  }
+
+  void enqueue(std::function<void()> job) {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->jobs.push_back(std::move(job));
+    }
+    this->wakeUp.notify_one();
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->drained.wait(lock, [this]() { return this->jobs.empty() && this->running == 0; });
+  }
+
+  void work() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true) {
+      this->wakeUp.wait(lock, [this]() { return this->stopping || !this->jobs.empty(); });
+      if (this->stopping) { return; }
+      {
+        std::function<void()> job = std::move(this->jobs.front());
+        this->jobs.pop_front();
+        this->running++;
+        lock.unlock();
+        job();
+      }
+      lock.lock();
+      this->running--;
+      if (this->jobs.empty() && this->running == 0) {
+        this->drained.notify_all();
+      }
+    }
+  }
+};
+
+inline WorkerPool &sharedWorkerPool() {
+  static WorkerPool pool(WorkerPool::defaultThreadsCount());
+  return pool;
+}
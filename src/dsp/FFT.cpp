@@ -0,0 +1,50 @@
+#include "FFT.hpp"
+#include <cmath>
+#include <utility>
+
+FFT::FFT(int size) {
+  this->size = size;
+  this->reversed.resize(size);
+  int bits = 0;
+  while ((1 << bits) < size) { bits++; }
+  for (int i = 0; i < size; i++) {
+    int r = 0;
+    for (int b = 0; b < bits; b++) {
+      r |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    this->reversed[i] = r;
+  }
+  this->twiddles.resize(size / 2);
+  for (int k = 0; k < size / 2; k++) {
+    double angle = 2.0 * M_PI * k / size;
+    this->twiddles[k] = std::complex<float>(cos(angle), sin(angle));
+  }
+}
+
+void FFT::forward(std::complex<float> *data) const {
+  this->transform(data, false);
+}
+
+void FFT::inverse(std::complex<float> *data) const {
+  this->transform(data, true);
+}
+
+void FFT::transform(std::complex<float> *data, bool inverse) const {
+  for (int i = 0; i < this->size; i++) {
+    if (i < this->reversed[i]) {
+      std::swap(data[i], data[this->reversed[i]]);
+    }
+  }
+  for (int half = 1; half < this->size; half <<= 1) {
+    int stride = this->size / (half * 2);
+    for (int start = 0; start < this->size; start += half * 2) {
+      for (int k = 0; k < half; k++) {
+        std::complex<float> w = this->twiddles[k * stride];
+        if (!inverse) { w = std::conj(w); }
+        std::complex<float> odd = data[start + k + half] * w;
+        data[start + k + half] = data[start + k] - odd;
+        data[start + k] += odd;
+      }
+    }
+  }
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <complex>
+#include <vector>
+
+/*
+ * Radix-2 complex FFT with precomputed twiddles and bit reversal, meant to be
+ * built once and reused for a whole batch of transforms of the same size.
+ * Transforms are unnormalized.
+ */
+struct FFT {
+  int size;
+  std::vector<int> reversed;
+  std::vector<std::complex<float>> twiddles; // e^(2 pi i k / size), k < size / 2
+
+  FFT(int size);
+  void forward(std::complex<float> *data) const;
+  void inverse(std::complex<float> *data) const;
+
+private:
+  void transform(std::complex<float> *data, bool inverse) const;
+};
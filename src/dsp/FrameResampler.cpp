@@ -0,0 +1,78 @@
+#include "FrameResampler.hpp"
+#include <algorithm>
+#include <cmath>
+
+static int greatestCommonDivisor(int a, int b) {
+  while (b) {
+    int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+FrameResampler::FrameResampler(int inSize, int outSize, ResampleQuality quality) {
+  this->inSize = inSize;
+  this->outSize = outSize;
+
+  int zeroCrossings = quality == RESAMPLE_HIGH ? 32 : 8;
+  // Downsampling lowers the cutoff to the new Nyquist, which widens the kernel
+  // by as much; the transition band sits just below the cutoff
+  double cutoff = std::min(1.0, (double)outSize / inSize) * (quality == RESAMPLE_HIGH ? 0.97 : 0.9);
+  this->halfTaps = (int)std::ceil(zeroCrossings / cutoff);
+  this->taps = 2 * this->halfTaps;
+  this->phases = outSize / greatestCommonDivisor(inSize, outSize);
+  this->kernels.resize((size_t)this->phases * this->taps);
+  this->padded.resize(inSize + 2 * this->halfTaps);
+
+  for (int p = 0; p < this->phases; p++) {
+    double frac = (double)p / this->phases;
+    float *kernel = &this->kernels[(size_t)p * this->taps];
+    double sum = 0.0;
+    for (int t = 0; t < this->taps; t++) {
+      double d = t - (this->halfTaps - 1) - frac;
+      double x = M_PI * cutoff * d;
+      double sinc = x == 0.0 ? 1.0 : sin(x) / x;
+      // Blackman-Harris window over [-halfTaps, halfTaps]
+      double w = 2.0 * M_PI * (d + this->halfTaps) / (2.0 * this->halfTaps);
+      double window = 0.35875 - 0.48829 * cos(w) + 0.14128 * cos(2.0 * w) - 0.01168 * cos(3.0 * w);
+      kernel[t] = sinc * window;
+      sum += kernel[t];
+    }
+    // Unity gain at DC for every phase
+    for (int t = 0; t < this->taps; t++) {
+      kernel[t] /= sum;
+    }
+  }
+}
+
+void FrameResampler::process(const float *in, float *out) {
+  int n = this->inSize;
+  for (int i = 0; i < (int)this->padded.size(); i++) {
+    int source = (i - this->halfTaps) % n;
+    this->padded[i] = in[source < 0 ? source + n : source];
+  }
+
+  // Output j sits at input position j * inSize / outSize, i.e. at sample
+  // position / outSize plus phase (position % outSize) / outSize
+  int step = this->outSize / this->phases;
+  long long position = 0;
+  for (int j = 0; j < this->outSize; j++, position += n) {
+    int i0 = (int)(position / this->outSize);
+    int phase = (int)(position % this->outSize) / step;
+    const float *kernel = &this->kernels[(size_t)phase * this->taps];
+    const float *window = &this->padded[i0 + 1];
+    float acc = 0.f;
+    for (int t = 0; t < this->taps; t++) {
+      acc += kernel[t] * window[t];
+    }
+    out[j] = acc;
+  }
+}
+
+int nearestPowerOfTwo(int size, int maxSize) {
+  int lower = 2;
+  while (lower * 2 <= size && lower * 2 <= maxSize) { lower *= 2; }
+  if (lower * 2 > maxSize) { return lower; }
+  return size - lower <= lower * 2 - size ? lower : lower * 2;
+}
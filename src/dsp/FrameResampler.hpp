@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+
+/*
+ * Windowed-sinc resampling of single-cycle frames to another length, used to
+ * bring tables with non-power-of-two frames to a size the mipmapping handles.
+ * Frames are periodic, so the kernel wraps around the frame ends. Output
+ * positions only fall on outSize / gcd(inSize, outSize) distinct fractional
+ * offsets, so every kernel phase is computed exactly once up front and each
+ * output sample is a single contiguous dot product.
+ */
+
+enum ResampleQuality {
+  RESAMPLE_FAST, // 8 zero crossings per side, exact to -80 dB up to half of the Nyquist frequency
+  RESAMPLE_HIGH, // 32 zero crossings per side, exact to -100 dB up to 80% of it, about 3x slower
+};
+
+struct FrameResampler {
+  int inSize;
+  int outSize;
+  int taps;
+  int halfTaps;
+  int phases;
+  std::vector<float> kernels; // phases x taps
+  std::vector<float> padded;  // one input frame with halfTaps of wrap-around on each side
+
+  FrameResampler(int inSize, int outSize, ResampleQuality quality);
+  void process(const float *in, float *out);
+};
+
+// Power of two closest to size within [2, maxSize]
+int nearestPowerOfTwo(int size, int maxSize);
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+/*
+ * IEEE 754 half precision conversions for tables kept at 16 bits per sample.
+ * Uses F16C when the build targets it and exact bit twiddling otherwise;
+ * both round to nearest even. Table samples never get near the limits of the
+ * half range, where the two may disagree on saturating.
+ */
+
+inline float halfToFloat(uint16_t h) {
+#ifdef __F16C__
+  return _cvtsh_ss(h);
+#else
+  // Moving the exponent and mantissa into place and scaling by 2^112 rebiases
+  // the exponent, subnormals included
+  uint32_t bits = (uint32_t)(h & 0x7fff) << 13;
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  f *= 5.192296858534828e33f;
+  memcpy(&bits, &f, sizeof(f));
+  bits |= (uint32_t)(h & 0x8000) << 16;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+#endif
+}
+
+inline uint16_t floatToHalf(float f) {
+#ifdef __F16C__
+  return _cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT);
+#else
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(f));
+  uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+  uint16_t h;
+  if (bits >= 0x477ff000u) {
+    // At or above 65520, which would round up to infinity; NaN stays NaN
+    h = bits > 0x7f800000u ? 0x7e00 : 0x7bff;
+  } else if (bits < 0x38800000u) {
+    // Below the smallest normal half: adding 0.5 lets the FPU do the rounding
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    value += 0.5f;
+    uint32_t rounded;
+    memcpy(&rounded, &value, sizeof(value));
+    h = (uint16_t)(rounded - 0x3f000000u);
+  } else {
+    uint32_t mantissaOdd = (bits >> 13) & 1;
+    bits += ((uint32_t)(15 - 127) << 23) + 0xfff + mantissaOdd;
+    h = (uint16_t)(bits >> 13);
+  }
+  return h | (uint16_t)(sign >> 16);
+#endif
+}
+
+inline void halfToFloatBlock(const uint16_t *in, float *out, size_t count) {
+  size_t i = 0;
+#ifdef __F16C__
+  for (; i + 8 <= count; i += 8) {
+    __m128i halves = _mm_loadu_si128((const __m128i *)(in + i));
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(halves));
+  }
+#endif
+  for (; i < count; i++) {
+    out[i] = halfToFloat(in[i]);
+  }
+}
+
+inline void floatToHalfBlock(const float *in, uint16_t *out, size_t count) {
+  size_t i = 0;
+#ifdef __F16C__
+  for (; i + 8 <= count; i += 8) {
+    __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128((__m128i *)(out + i), halves);
+  }
+#endif
+  for (; i < count; i++) {
+    out[i] = floatToHalf(in[i]);
+  }
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <cmath>
+#include <cstring>
+
+/*
+ * Polyphase halfband filters for 2x and 4x oversampling. A halfband FIR has
+ * every other tap at zero, so each 2x stage only runs one dot product per
+ * input (upsampling) or output (decimation) sample; the other phase is a
+ * plain delay. Histories are kept twice in a row so that the dot products
+ * always read contiguous memory and get vectorized.
+ */
+
+template <int HALF>
+struct HalfbandFilter {
+  // HALF is the (odd) distance from the center to the outermost nonzero tap
+  static const int TAPS = HALF + 1;
+  float taps[TAPS]; // nonzero taps at odd distances from the center, outermost first
+
+  HalfbandFilter() {
+    int length = 2 * HALF + 1;
+    double sum = 0.0;
+    double full[2 * HALF + 1];
+    for (int k = 0; k < length; k++) {
+      int d = k - HALF;
+      double sinc = d == 0 ? 0.5 : sin(M_PI * d * 0.5) / (M_PI * d);
+      // Blackman-Harris window
+      double x = 2.0 * M_PI * (k + 1) / (length + 1);
+      double window = 0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2.0 * x) - 0.01168 * cos(3.0 * x);
+      full[k] = sinc * window;
+      sum += full[k];
+    }
+    for (int i = 0; i < TAPS; i++) {
+      this->taps[i] = full[2 * i] / sum;
+    }
+    this->center = full[HALF] / sum;
+  }
+
+  float center;
+};
+
+template <int HALF>
+struct HalfbandUpsampler {
+  static const int TAPS = HalfbandFilter<HALF>::TAPS;
+  static const int DELAY = (HALF - 1) / 2;
+  HalfbandFilter<HALF> filter;
+  float history[2 * TAPS] = {};
+  int pos = 0;
+
+  // Writes 2 output samples for every input sample
+  void process(float in, float *out) {
+    this->history[this->pos] = in;
+    this->history[this->pos + TAPS] = in;
+    this->pos = this->pos + 1 == TAPS ? 0 : this->pos + 1;
+    const float *window = &this->history[this->pos];
+    float acc = 0.f;
+    for (int i = 0; i < TAPS; i++) {
+      acc += this->filter.taps[i] * window[i];
+    }
+    out[0] = 2.f * acc;
+    out[1] = 2.f * this->filter.center * window[TAPS - 1 - DELAY];
+  }
+};
+
+template <int HALF>
+struct HalfbandDecimator {
+  static const int TAPS = HalfbandFilter<HALF>::TAPS;
+  static const int DELAY = (HALF - 1) / 2;
+  HalfbandFilter<HALF> filter;
+  float even[2 * TAPS] = {};
+  float odd[2 * TAPS] = {};
+  int pos = 0;
+
+  // Takes 2 input samples for every output sample
+  float process(const float *in) {
+    this->even[this->pos] = in[0];
+    this->even[this->pos + TAPS] = in[0];
+    this->odd[this->pos] = in[1];
+    this->odd[this->pos + TAPS] = in[1];
+    this->pos = this->pos + 1 == TAPS ? 0 : this->pos + 1;
+    const float *window = &this->odd[this->pos];
+    float acc = 0.f;
+    for (int i = 0; i < TAPS; i++) {
+      acc += this->filter.taps[i] * window[i];
+    }
+    return acc + this->filter.center * this->even[this->pos + TAPS - 1 - DELAY];
+  }
+};
+
+/*
+ * 1x, 2x or 4x around a per-sample process: upsample() spreads one input
+ * sample over `factor` samples, downsample() folds `factor` samples back.
+ * The stage next to the base rate is the long one, as it has to reject
+ * everything above the original Nyquist.
+ */
+struct Oversampler {
+  static const int MAX_FACTOR = 4;
+  int factor = 1;
+  HalfbandUpsampler<23> up2;
+  HalfbandUpsampler<7> up4;
+  HalfbandDecimator<23> down2;
+  HalfbandDecimator<7> down4;
+
+  void setFactor(int newFactor) {
+    if (newFactor == this->factor) { return; }
+    this->factor = newFactor;
+    this->reset();
+  }
+
+  void reset() {
+    memset(this->up2.history, 0, sizeof(this->up2.history));
+    memset(this->up4.history, 0, sizeof(this->up4.history));
+    memset(this->down2.even, 0, sizeof(this->down2.even));
+    memset(this->down2.odd, 0, sizeof(this->down2.odd));
+    memset(this->down4.even, 0, sizeof(this->down4.even));
+    memset(this->down4.odd, 0, sizeof(this->down4.odd));
+  }
+
+  void upsample(float in, float *out) {
+    if (this->factor == 1) {
+      out[0] = in;
+    } else if (this->factor == 2) {
+      this->up2.process(in, out);
+    } else {
+      float half[2];
+      this->up2.process(in, half);
+      this->up4.process(half[0], out);
+      this->up4.process(half[1], out + 2);
+    }
+  }
+
+  float downsample(const float *in) {
+    if (this->factor == 1) {
+      return in[0];
+    } else if (this->factor == 2) {
+      return this->down2.process(in);
+    }
+    float half[2] = { this->down4.process(in), this->down4.process(in + 2) };
+    return this->down2.process(half);
+  }
+};
@@ -3,6 +3,8 @@
  */
 
 #include "Wavetable.hpp"
+#include "HalfFloat.hpp"
+#include "Oversampler.hpp"
 #include <assert.h>
 #include <cstring>
 #include <iostream>
@@ -41,7 +43,7 @@ const int HRFilterI16[64] = {
 const int FIRipolI16_N = 8;
 const int FIRoffsetI16 = FIRipolI16_N >> 1;
 
-unsigned int limit_range(unsigned int x, unsigned int l, unsigned int h)
+int limit_range(int x, int l, int h)
 {
     return std::max(std::min(x, h), l);
 }
@@ -50,7 +52,7 @@ void float2i15_block(float *f, short *s, int n)
 {
     for (int i = 0; i < n; i++)
     {
-        s[i] = (short)(int)limit_range((int)((float)f[i] * 16384.f), -16384, 16383);
+        s[i] = (short)limit_range((int)((float)f[i] * 16384.f), -16384, 16383);
     }
 }
 
@@ -76,7 +78,13 @@ int min_F32_tables = 3;
 #if ARCH_MAC || ARCH_LIN
 bool _BitScanReverse(unsigned int *result, unsigned int bits)
 {
-    *result = __builtin_ctz(bits);
+    // Index of the highest set bit like the MSVC intrinsic, ctz only agreed for powers of two
+    if (!bits)
+    {
+        *result = 0;
+        return false;
+    }
+    *result = 31 - __builtin_clz(bits);
     return true;
 }
 #endif
@@ -97,6 +105,24 @@ size_t RequiredWTSize(int TableSize, int TableCount)
     return Size;
 }
 
+// Mipmaps take up to twice the frames plus some padding per level
+int MaxWTFrames(int TableSize)
+{
+    return std::min(max_subtables, (max_wtable_samples - max_wtable_size) / (2 * TableSize + 256));
+}
+
+static std::atomic<size_t> storage_bytes(0);
+
+size_t WavetableStorageBytes() { return storage_bytes; }
+
+void Wavetable::accountStorage()
+{
+    size_t bytes = TableF16Data ? dataSizes * sizeof(uint16_t) : dataSizes * (sizeof(float) + sizeof(short));
+    storage_bytes += bytes;
+    storage_bytes -= accounted_bytes;
+    accounted_bytes = bytes;
+}
+
 int GetWTIndex(int WaveIdx, int WaveSize, int NumWaves, int MipMap, int Padding = 0)
 {
     int Index = WaveIdx * ((WaveSize >> MipMap) + Padding);
@@ -114,13 +140,21 @@ Wavetable::Wavetable()
 {
     std::cout << "Wavetable() <" << this << ">" << std::endl;
     n_tables = 0;
+    n_data_tables = 0;
+    n_rows = 1;
+    mipmaps_ready = false;
+    mipmaps_fast = false;
     dataSizes = 35000;
+    accounted_bytes = 0;
+    TableF16Data = nullptr;
     TableF32Data = (float *)malloc(dataSizes * sizeof(float));
     TableI16Data = (short *)malloc(dataSizes * sizeof(short));
+    accountStorage();
     memset(TableF32Data, 0, dataSizes * sizeof(float));
     memset(TableI16Data, 0, dataSizes * sizeof(short));
     memset(TableF32WeakPointers, 0, sizeof(TableF32WeakPointers));
     memset(TableI16WeakPointers, 0, sizeof(TableI16WeakPointers));
+    memset(TableF16WeakPointers, 0, sizeof(TableF16WeakPointers));
     current_id = -1;
     queue_id = -1;
     refresh_display = true; // I have never been drawn so assume I need refresh if asked
@@ -129,39 +163,71 @@ Wavetable::Wavetable()
 Wavetable::~Wavetable()
 {
     std::cout << "~Wavetable() <" << this << ">" << std::endl;
-    free(TableF32Data);
-    free(TableI16Data);
+    storage_bytes -= accounted_bytes;
+    if (!external_storage)
+    {
+        free(TableF32Data);
+        free(TableI16Data);
+    }
+    free(TableF16Data);
 }
 
 void Wavetable::allocPointers(size_t newSize)
 {
-    free(TableF32Data);
-    free(TableI16Data);
+    if (!external_storage)
+    {
+        free(TableF32Data);
+        free(TableI16Data);
+    }
+    external_storage.reset();
+    free(TableF16Data);
+    TableF16Data = nullptr;
+    memset(TableF16WeakPointers, 0, sizeof(TableF16WeakPointers));
     dataSizes = newSize;
     TableF32Data = (float *)malloc(dataSizes * sizeof(float));
     TableI16Data = (short *)malloc(dataSizes * sizeof(short));
+    accountStorage();
     memset(TableF32Data, 0, dataSizes * sizeof(float));
     memset(TableI16Data, 0, dataSizes * sizeof(short));
 }
 
-bool Wavetable::BuildWT(void *wdata, wt_header &wh, bool AppendSilence)
+bool Wavetable::BuildWT(void *wdata, wt_header &wh, bool AppendSilence, bool BuildMipmaps)
 {
     assert(wdata);
+    mipmaps_ready = false;
+    mipmaps_fast = false;
 
     std::cout << "Flags: " << wh.flags << std::endl;
 
+    int n_samples = vt_read_int32LE(wh.n_samples);
+    if (n_samples < 2 || (n_samples & (n_samples - 1)))
+    {
+        // Mipmap addressing masks with size - 1, see SurgeStorage::build_wt for resampling
+        std::cout << "Wavetable frames must be a power of two long, got " << n_samples << std::endl;
+        return false;
+    }
+
+    int tables = vt_read_int16LE(wh.n_tables);
+    if (tables < 1 || tables + (AppendSilence ? 3 : 0) > MaxWTFrames(n_samples))
+    {
+        std::cout << "Wavetable of " << tables << " frames of " << n_samples << " samples does not fit" << std::endl;
+        return false;
+    }
+
     flags = vt_read_int16LE(wh.flags);
-    n_tables = vt_read_int16LE(wh.n_tables);
-    size = vt_read_int32LE(wh.n_samples);
+    n_tables = tables;
+    size = n_samples;
 
     size_t req_size = RequiredWTSize(size, n_tables);
 
-    if (req_size > dataSizes)
+    if (req_size > dataSizes || external_storage || TableF16Data)
     {
         allocPointers(req_size);
     }
 
     int wdata_tables = n_tables;
+    n_data_tables = wdata_tables;
+    n_rows = 1;
 
     if (AppendSilence)
     {
@@ -253,13 +319,255 @@ bool Wavetable::BuildWT(void *wdata, wt_header &wh, bool AppendSilence)
                FIRoffsetI16 * sizeof(short));
     }
 
-    MipMapWT();
+    if (BuildMipmaps)
+        MipMapWT();
     this->refresh_display = true;
     return true;
 }
 
-void Wavetable::MipMapWT()
+void Wavetable::AttachData(std::shared_ptr<void> storage, float *f32, short *i16, size_t count)
+{
+    if (!external_storage)
+    {
+        free(TableF32Data);
+        free(TableI16Data);
+    }
+    external_storage = storage;
+    free(TableF16Data);
+    TableF16Data = nullptr;
+    memset(TableF16WeakPointers, 0, sizeof(TableF16WeakPointers));
+    TableF32Data = f32;
+    TableI16Data = i16;
+    dataSizes = count;
+    accountStorage();
+
+#if ARCH_WIN
+    unsigned long MSBpos;
+    _BitScanReverse(&MSBpos, size);
+#else
+    unsigned int MSBpos;
+    _BitScanReverse(&MSBpos, size);
+#endif
+    size_po2 = MSBpos;
+    dt = 1.0f / size;
+
+    int levels = 1;
+    while (((1 << levels) < size) & (levels < max_mipmap_levels))
+        levels++;
+    for (int l = 0; l < levels; l++)
+    {
+        for (int j = 0; j < n_tables; j++)
+        {
+            TableF32WeakPointers[l][j] = TableF32Data + GetWTIndex(j, size, n_tables, l);
+            TableI16WeakPointers[l][j] =
+                TableI16Data + GetWTIndex(j, size, n_tables, l, FIRipolI16_N);
+        }
+    }
+    for (int j = n_tables; j < min_F32_tables; j++)
+    {
+        unsigned int s = size;
+        int l = 0;
+        while (s && (l < max_mipmap_levels))
+        {
+            TableF32WeakPointers[l][j] = TableF32Data + GetWTIndex(j, size, n_tables, l);
+            s = s >> 1;
+            l++;
+        }
+    }
+
+    mipmaps_fast = false;
+    mipmaps_ready = true;
+    refresh_display = true;
+}
+
+bool Wavetable::BuildWTFromMipmaps(int TableSize, int TableCount, float *const *levels)
+{
+    if (TableSize < 2 || TableSize > max_wtable_size || (TableSize & (TableSize - 1)) ||
+        TableCount < 1 || TableCount > MaxWTFrames(TableSize))
+        return false;
+
+    mipmaps_ready = false;
+    mipmaps_fast = false;
+    flags = 0;
+    size = TableSize;
+    n_tables = TableCount;
+    n_data_tables = TableCount;
+    n_rows = 1;
+
+    size_t req_size = RequiredWTSize(size, n_tables);
+    if (req_size > dataSizes || external_storage || TableF16Data)
+    {
+        allocPointers(req_size);
+    }
+
+#if ARCH_WIN
+    unsigned long MSBpos;
+    _BitScanReverse(&MSBpos, size);
+#else
+    unsigned int MSBpos;
+    _BitScanReverse(&MSBpos, size);
+#endif
+    size_po2 = MSBpos;
+    dt = 1.0f / size;
+
+    // Cleared first like in BuildWT, as these overlap the next level when n_tables < 3
+    for (int j = n_tables; j < min_F32_tables; j++)
+    {
+        unsigned int s = size;
+        int l = 0;
+        while (s && (l < max_mipmap_levels))
+        {
+            TableF32WeakPointers[l][j] = TableF32Data + GetWTIndex(j, size, n_tables, l);
+            memset(TableF32WeakPointers[l][j], 0, s * sizeof(float));
+            s = s >> 1;
+            l++;
+        }
+    }
+
+    int nlevels = 1;
+    while (((1 << nlevels) < size) & (nlevels < max_mipmap_levels))
+        nlevels++;
+    for (int l = 0; l < nlevels; l++)
+    {
+        int lsize = size >> l;
+        for (int j = 0; j < n_tables; j++)
+        {
+            TableF32WeakPointers[l][j] = TableF32Data + GetWTIndex(j, size, n_tables, l);
+            TableI16WeakPointers[l][j] =
+                TableI16Data + GetWTIndex(j, size, n_tables, l, FIRipolI16_N);
+
+            memcpy(TableF32WeakPointers[l][j], &levels[l][j * lsize], lsize * sizeof(float));
+            float2i15_block(TableF32WeakPointers[l][j], &TableI16WeakPointers[l][j][FIRoffsetI16],
+                            lsize);
+            memcpy(&TableI16WeakPointers[l][j][lsize + FIRoffsetI16],
+                   &TableI16WeakPointers[l][j][FIRoffsetI16], FIRoffsetI16 * sizeof(short));
+            memcpy(&TableI16WeakPointers[l][j][0], &TableI16WeakPointers[l][j][lsize],
+                   FIRoffsetI16 * sizeof(short));
+        }
+    }
+    mipmaps_fast = false;
+    mipmaps_ready = true;
+    refresh_display = true;
+    return true;
+}
+
+bool Wavetable::ConvertToHalf()
+{
+    if (TableF16Data)
+        return true;
+    if (!mipmaps_ready)
+        return false;
+
+    uint16_t *f16 = (uint16_t *)malloc(dataSizes * sizeof(uint16_t));
+    if (!f16)
+        return false;
+    floatToHalfBlock(TableF32Data, f16, dataSizes);
+
+    // Same layout, so every frame sits at the same offset as its float original
+    for (int l = 0; l < max_mipmap_levels; l++)
+    {
+        for (int j = 0; j < max_subtables; j++)
+        {
+            TableF16WeakPointers[l][j] =
+                TableF32WeakPointers[l][j] ? f16 + (TableF32WeakPointers[l][j] - TableF32Data) : nullptr;
+        }
+    }
+
+    if (!external_storage)
+    {
+        free(TableF32Data);
+        free(TableI16Data);
+    }
+    external_storage.reset();
+    TableF32Data = nullptr;
+    TableI16Data = nullptr;
+    memset(TableF32WeakPointers, 0, sizeof(TableF32WeakPointers));
+    memset(TableI16WeakPointers, 0, sizeof(TableI16WeakPointers));
+    TableF16Data = f16;
+    accountStorage();
+    return true;
+}
+
+void Wavetable::ReadFrame(int level, int frame, float *out)
+{
+    int lsize = size >> level;
+    if (TableF16Data)
+        halfToFloatBlock(TableF16WeakPointers[level][frame], out, lsize);
+    else
+        memcpy(out, TableF32WeakPointers[level][frame], lsize * sizeof(float));
+}
+
+bool Wavetable::CopyLevelZero(Wavetable *wt)
 {
+    if (!wt->TableF32Data)
+        return false;
+
+    // Level 0 frames are contiguous, and already converted to float
+    wt_header wh;
+    memset(&wh, 0, sizeof(wt_header));
+    wh.n_samples = wt->size;
+    wh.n_tables = wt->n_data_tables;
+    wh.flags = wt->flags & ~(wtf_int16 | wtf_int16_is_16);
+    if (!BuildWT(wt->TableF32Data, wh, wt->n_tables != wt->n_data_tables, false))
+        return false;
+    flags = wt->flags;
+    n_rows = wt->n_rows;
+    return true;
+}
+
+void Wavetable::MipMapWTFast()
+{
+    // 15 taps instead of 63, and the int16 levels converted rather than filtered on their own
+    static const HalfbandFilter<7> filter;
+    const int half = 7;
+
+    int levels = 1;
+    while (((1 << levels) < size) & (levels < max_mipmap_levels))
+        levels++;
+
+    for (int l = 1; l < levels; l++)
+    {
+        int psize = size >> (l - 1);
+        int lsize = size >> l;
+
+        for (int s = 0; s < n_tables; s++)
+        {
+            this->TableF32WeakPointers[l][s] = TableF32Data + GetWTIndex(s, size, n_tables, l);
+            this->TableI16WeakPointers[l][s] =
+                TableI16Data + GetWTIndex(s, size, n_tables, l, FIRipolI16_N);
+
+            const float *src = this->TableF32WeakPointers[l - 1][s];
+            float *dst = this->TableF32WeakPointers[l][s];
+            for (int i = 0; i < lsize; i++)
+            {
+                float acc = filter.center * src[(i << 1) & (psize - 1)];
+                for (int t = 0; t < filter.TAPS; t++)
+                {
+                    acc += filter.taps[t] * src[((i << 1) + 2 * t - half) & (psize - 1)];
+                }
+                dst[i] = acc;
+            }
+
+            float2i15_block(dst, &this->TableI16WeakPointers[l][s][FIRoffsetI16], lsize);
+            memcpy(&this->TableI16WeakPointers[l][s][lsize + FIRoffsetI16],
+                   &this->TableI16WeakPointers[l][s][FIRoffsetI16], FIRoffsetI16 * sizeof(short));
+            memcpy(&this->TableI16WeakPointers[l][s][0], &this->TableI16WeakPointers[l][s][lsize],
+                   FIRoffsetI16 * sizeof(short));
+        }
+    }
+    mipmaps_fast = true;
+    mipmaps_ready = true;
+}
+
+void Wavetable::MipMapWT(bool Fast)
+{
+    // Samples are filtered across frames, which only the full cascade does
+    if (Fast && !(this->flags & wtf_is_sample))
+    {
+        MipMapWTFast();
+        return;
+    }
+
     int levels = 1;
     while (((1 << levels) < size) & (levels < max_mipmap_levels))
         levels++;
@@ -332,6 +640,8 @@ void Wavetable::MipMapWT()
         // fwrite(this->TableI16WeakPointers[l][0],lsize*sizeof(short),1,F);
     }
     // fclose(F);
+    mipmaps_fast = false;
+    mipmaps_ready = true;
 
     // TODO I16 mipmaps end up out of phase
     // The click/knot/bug probably results from the fact that there is no padding in the beginning,
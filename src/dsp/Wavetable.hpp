@@ -3,7 +3,10 @@
  */
 
 #pragma once
+#include <atomic>
+#include <cstdint>
 #include <cstring>
+#include <memory>
 #include <string>
 const int max_wtable_size = 4096;
 const int max_subtables = 512;
@@ -59,32 +62,65 @@ struct wt_header
 };
 #pragma pack(pop)
 
+size_t RequiredWTSize(int TableSize, int TableCount);
+// Most frames, padding frames included, whose mipmaps stay within max_wtable_samples
+int MaxWTFrames(int TableSize);
+// Bytes of sample data held by all Wavetable instances, mapped banks included
+size_t WavetableStorageBytes();
+
 class Wavetable
 {
   public:
     Wavetable();
     ~Wavetable();
     void Copy(Wavetable *wt);
-    bool BuildWT(void *wdata, wt_header &wh, bool AppendSilence);
-    void MipMapWT();
+    bool BuildWT(void *wdata, wt_header &wh, bool AppendSilence, bool BuildMipmaps = true);
+    // Fast builds the levels with a short filter in a fraction of the time, good enough to
+    // play from until a full quality copy is ready (see CopyLevelZero)
+    void MipMapWT(bool Fast = false);
+    // Takes the frames of wt's level 0 as they are, for its mipmaps to be built again
+    bool CopyLevelZero(Wavetable *wt);
+    // Takes every level ready made (e.g. synthesized band-limited), levels[l] holds
+    // TableCount frames of TableSize >> l samples for each level MipMapWT would build.
+    bool BuildWTFromMipmaps(int TableSize, int TableCount, float *const *levels);
 
     void allocPointers(size_t newSize);
+    // Uses already mipmapped data owned by storage (e.g. a mapped file) instead of building it.
+    // size, n_tables, n_data_tables and flags must be set beforehand.
+    void AttachData(std::shared_ptr<void> storage, float *f32, short *i16, size_t count);
+    // Keeps every level as half floats from then on and frees the float and int16 data.
+    // Needs the mipmaps built, the table can not be rebuilt in place afterwards.
+    bool ConvertToHalf();
+    // Widens one frame of a level into out, whichever way the table is stored
+    void ReadFrame(int level, int frame, float *out);
+
+  private:
+    void accountStorage();
+    void MipMapWTFast();
 
   public:
     int size;
     int n_tables;
+    int n_data_tables; // n_tables without the appended silence
+    int n_rows;        // frames form a row-major grid of n_rows x (n_tables / n_rows), set after building
     int size_po2;
     int flags;
     float dt;
     float *TableF32WeakPointers[max_mipmap_levels][max_subtables];
     short *TableI16WeakPointers[max_mipmap_levels][max_subtables];
+    uint16_t *TableF16WeakPointers[max_mipmap_levels][max_subtables];
 
     size_t dataSizes;
     float *TableF32Data;
     short *TableI16Data;
+    uint16_t *TableF16Data; // set instead of the two above once converted to half floats
+    std::shared_ptr<void> external_storage; // set when Table*Data are not ours to free
+    size_t accounted_bytes;                  // share of WavetableStorageBytes()
 
     int current_id, queue_id;
     bool refresh_display;
+    std::atomic<bool> mipmaps_ready; // levels above 0 may only be read once this is set
+    bool mipmaps_fast;               // levels were built by MipMapWT(true)
     char queue_filename[256];
 };
 
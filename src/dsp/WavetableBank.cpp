@@ -0,0 +1,141 @@
+#include "WavetableBank.hpp"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if ARCH_WIN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint64_t alignUp(uint64_t value) {
+  return (value + wt_bank_alignment - 1) / wt_bank_alignment * wt_bank_alignment;
+}
+
+bool writeWavetableBank(Wavetable *wt, const std::string &path) {
+  // Banks hold the float and int16 levels, half float tables have neither
+  if (wt->n_data_tables <= 0 || !wt->mipmaps_ready || !wt->TableF32Data) { return false; }
+
+  wt_bank_header header;
+  memset(&header, 0, sizeof(wt_bank_header));
+  memcpy(header.tag, "ZWTB", 4);
+  header.version = wt_bank_version;
+  header.size = wt->size;
+  header.n_tables = wt->n_tables;
+  header.n_data_tables = wt->n_data_tables;
+  header.flags = wt->flags;
+  header.n_rows = wt->n_rows;
+  header.count = RequiredWTSize(wt->size, wt->n_data_tables);
+  header.f32_offset = sizeof(wt_bank_header);
+  header.i16_offset = alignUp(header.f32_offset + header.count * sizeof(float));
+
+  FILE *f = fopen(path.c_str(), "wb");
+  if (!f) {
+    std::cout << "Unable to write '" << path << "'!" << std::endl;
+    return false;
+  }
+  std::vector<char> padding(wt_bank_alignment, 0);
+  uint64_t f32End = header.f32_offset + header.count * sizeof(float);
+  bool written = fwrite(&header, sizeof(wt_bank_header), 1, f) == 1 &&
+    fwrite(wt->TableF32Data, sizeof(float), header.count, f) == header.count &&
+    fwrite(padding.data(), 1, header.i16_offset - f32End, f) == header.i16_offset - f32End &&
+    fwrite(wt->TableI16Data, sizeof(short), header.count, f) == header.count;
+  written = (fclose(f) == 0) && written;
+  return written;
+}
+
+#if ARCH_WIN
+struct BankMapping {
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = NULL;
+  void *data = nullptr;
+  uint64_t size = 0;
+
+  ~BankMapping() {
+    if (data) { UnmapViewOfFile(data); }
+    if (mapping) { CloseHandle(mapping); }
+    if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+  }
+
+  bool open(const std::string &path) {
+    int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+    std::vector<wchar_t> widePath(length);
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, widePath.data(), length);
+    file = CreateFileW(widePath.data(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) { return false; }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) { return false; }
+    size = fileSize.QuadPart;
+    mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) { return false; }
+    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    return data != nullptr;
+  }
+};
+#else
+struct BankMapping {
+  void *data = nullptr;
+  uint64_t size = 0;
+
+  ~BankMapping() {
+    if (data) { munmap(data, size); }
+  }
+
+  bool open(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) { return false; }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd);
+      return false;
+    }
+    size = st.st_size;
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) { return false; }
+    data = mapped;
+    return true;
+  }
+};
+#endif
+
+bool loadWavetableBank(const std::string &path, Wavetable *wt) {
+  std::shared_ptr<BankMapping> mapping = std::make_shared<BankMapping>();
+  if (!mapping->open(path)) {
+    std::cout << "Unable to map '" << path << "'!" << std::endl;
+    return false;
+  }
+  if (mapping->size < sizeof(wt_bank_header)) { return false; }
+
+  const wt_bank_header *header = (const wt_bank_header *)mapping->data;
+  bool valid = memcmp(header->tag, "ZWTB", 4) == 0 &&
+    header->version == wt_bank_version &&
+    header->size >= 2 && header->size <= (uint32_t)max_wtable_size &&
+    (header->size & (header->size - 1)) == 0 &&
+    header->n_data_tables > 0 && header->n_tables <= (uint32_t)MaxWTFrames(header->size) &&
+    header->n_data_tables <= header->n_tables && header->n_tables <= header->n_data_tables + 3 &&
+    header->count == RequiredWTSize(header->size, header->n_data_tables) &&
+    header->count <= (uint64_t)max_wtable_samples &&
+    header->f32_offset % wt_bank_alignment == 0 && header->i16_offset % wt_bank_alignment == 0 &&
+    header->f32_offset + header->count * sizeof(float) <= header->i16_offset &&
+    header->i16_offset + header->count * sizeof(short) <= mapping->size &&
+    (header->n_rows <= 1 || header->n_data_tables % header->n_rows == 0);
+  if (!valid) {
+    std::cout << "'" << path << "' is not a valid wavetable bank" << std::endl;
+    return false;
+  }
+
+  char *base = (char *)mapping->data;
+  wt->size = header->size;
+  wt->n_tables = header->n_tables;
+  wt->n_data_tables = header->n_data_tables;
+  wt->flags = header->flags;
+  wt->n_rows = header->n_rows > 1 ? header->n_rows : 1;
+  wt->AttachData(mapping, (float *)(base + header->f32_offset), (short *)(base + header->i16_offset), header->count);
+  return true;
+}
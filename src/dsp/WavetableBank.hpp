@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "Wavetable.hpp"
+
+/*
+ * Pre-baked wavetable file (.zwt): a fixed header followed by the complete
+ * float and int16 mipmap pyramids in Wavetable's own memory layout, so that a
+ * player can map the file and use it without parsing or filtering anything.
+ */
+
+const uint32_t wt_bank_version = 1;
+const uint32_t wt_bank_alignment = 64;
+
+struct wt_bank_header {
+  char tag[4]; // "ZWTB"
+  uint32_t version;
+  uint32_t size;
+  uint32_t n_tables;
+  uint32_t n_data_tables;
+  uint32_t flags;
+  uint64_t count; // entries in each of the float and int16 blocks
+  uint64_t f32_offset;
+  uint64_t i16_offset;
+  uint32_t n_rows; // of a 2D grid, 0 in files from before grids is the same as 1
+  uint8_t reserved[12];
+};
+
+static_assert(sizeof(wt_bank_header) == wt_bank_alignment, "Bank header must keep data aligned");
+
+bool writeWavetableBank(Wavetable *wt, const std::string &path);
+bool loadWavetableBank(const std::string &path, Wavetable *wt);
@@ -0,0 +1,415 @@
+#include "WavetableCodec.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+static const uint8_t CODEC_VERSION = 2;
+static const int HEADER_SIZE = 24; // 20 in version 1, which had no payload length
+static const int BLOCK_SIZE = 256;
+static const int ESCAPE_QUOTIENT = 24;
+static const float FLOAT_RANGE = 8388607.f; // 24 bit
+
+enum CodecFlags {
+  CODEC_FLOAT24 = 1,
+  CODEC_APPEND_SILENCE = 2,
+  CODEC_ACROSS_FRAMES = 4,
+  CODEC_ORDER_SHIFT = 3, // two bits of predictor order
+};
+
+static void putU16(uint8_t *p, uint32_t v) {
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+}
+
+static void putU32(uint8_t *p, uint32_t v) {
+  putU16(p, v & 0xffff);
+  putU16(p + 2, v >> 16);
+}
+
+static uint32_t getU16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t *p) {
+  return getU16(p) | (getU16(p + 2) << 16);
+}
+
+static inline uint32_t zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t u) {
+  return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+}
+
+// Fixed polynomial predictors of order 0..3, rows predict from previous rows.
+// The first rows fall back to the highest order they have history for.
+static void differentiate(const int32_t *x, int32_t *out, int rows, int cols, int order) {
+  for (int r = 0; r < rows; r++) {
+    const int32_t *row = x + r * cols;
+    int32_t *res = out + r * cols;
+    switch (std::min(order, r)) {
+      case 0:
+        for (int c = 0; c < cols; c++) { res[c] = row[c]; }
+        break;
+      case 1:
+        for (int c = 0; c < cols; c++) { res[c] = row[c] - row[c - cols]; }
+        break;
+      case 2:
+        for (int c = 0; c < cols; c++) { res[c] = row[c] - 2 * row[c - cols] + row[c - 2 * cols]; }
+        break;
+      default:
+        for (int c = 0; c < cols; c++) { res[c] = row[c] - 3 * (row[c - cols] - row[c - 2 * cols]) - row[c - 3 * cols]; }
+        break;
+    }
+  }
+}
+
+// Inverse of differentiate(), in place. The recurrence runs along rows, so the
+// inner loop is independent across columns and vectorizes.
+static void integrate(int32_t *x, int rows, int cols, int order) {
+  for (int r = 1; r < rows; r++) {
+    int32_t *row = x + r * cols;
+    switch (std::min(order, r)) {
+      case 0:
+        break;
+      case 1:
+        for (int c = 0; c < cols; c++) { row[c] += row[c - cols]; }
+        break;
+      case 2:
+        for (int c = 0; c < cols; c++) { row[c] += 2 * row[c - cols] - row[c - 2 * cols]; }
+        break;
+      default:
+        for (int c = 0; c < cols; c++) { row[c] += 3 * (row[c - cols] - row[c - 2 * cols]) + row[c - 3 * cols]; }
+        break;
+    }
+  }
+}
+
+static int riceParameter(const int32_t *res, int count) {
+  uint64_t sum = 0;
+  for (int i = 0; i < count; i++) {
+    sum += zigzag(res[i]);
+  }
+  uint64_t mean = sum / std::max(count, 1);
+  int k = 0;
+  while (k < 30 && (mean >> (k + 1)) > 0) {
+    k++;
+  }
+  return k;
+}
+
+static uint64_t riceCost(const int32_t *res, int count) {
+  uint64_t bits = 0;
+  for (int offset = 0; offset < count; offset += BLOCK_SIZE) {
+    int blockLength = std::min(BLOCK_SIZE, count - offset);
+    int k = riceParameter(res + offset, blockLength);
+    bits += 5 + (uint64_t)blockLength * (k + 1);
+    for (int i = 0; i < blockLength; i++) {
+      bits += std::min(zigzag(res[offset + i]) >> k, (uint32_t)ESCAPE_QUOTIENT + 32);
+    }
+  }
+  return bits;
+}
+
+struct BitWriter {
+  std::vector<uint8_t> &out;
+  uint64_t acc = 0;
+  int bits = 0;
+
+  BitWriter(std::vector<uint8_t> &out) : out(out) {}
+
+  void write(uint32_t value, int count) {
+    if (count > 24) {
+      write(value >> 16, count - 16);
+      write(value & 0xffff, 16);
+      return;
+    }
+    acc = (acc << count) | (value & ((1u << count) - 1));
+    bits += count;
+    while (bits >= 8) {
+      bits -= 8;
+      out.push_back((acc >> bits) & 0xff);
+    }
+  }
+
+  void writeZeros(int count) {
+    while (count > 16) {
+      write(0, 16);
+      count -= 16;
+    }
+    write(0, count);
+  }
+
+  void flush() {
+    if (bits > 0) {
+      write(0, 8 - bits);
+    }
+  }
+};
+
+struct BitReader {
+  const uint8_t *p;
+  const uint8_t *end;
+  uint64_t acc = 0; // MSB-first
+  int bits = 0;
+  uint64_t position = 0; // bits consumed, including any zero padding past the end
+  bool overrun = false;
+
+  BitReader(const uint8_t *p, const uint8_t *end) : p(p), end(end) {}
+
+  inline void refill() {
+    while (bits <= 56) {
+      if (p < end) {
+        acc |= (uint64_t)*p++ << (56 - bits);
+      } else if (bits == 0) {
+        overrun = true;
+        return;
+      }
+      bits += 8;
+    }
+  }
+
+  inline uint32_t read(int count) {
+    if (count == 0) { return 0; }
+    refill();
+    uint32_t value = (uint32_t)(acc >> (64 - count));
+    acc <<= count;
+    bits -= count;
+    position += count;
+    return value;
+  }
+
+  inline int readUnary(int limit) {
+    int zeros = 0;
+    while (!overrun) {
+      refill();
+      int run = acc ? __builtin_clzll(acc) : bits;
+      run = std::min(run, bits);
+      if (zeros + run > limit) {
+        overrun = true;
+        return limit;
+      }
+      if (run < bits) {
+        acc = run < 63 ? acc << (run + 1) : 0;
+        bits -= run + 1;
+        position += run + 1;
+        return zeros + run;
+      }
+      zeros += run;
+      position += run;
+      acc = 0;
+      bits = 0;
+    }
+    return limit;
+  }
+};
+
+static void writeRice(BitWriter &writer, const int32_t *res, int count) {
+  for (int offset = 0; offset < count; offset += BLOCK_SIZE) {
+    int blockLength = std::min(BLOCK_SIZE, count - offset);
+    int k = riceParameter(res + offset, blockLength);
+    writer.write(k, 5);
+    for (int i = 0; i < blockLength; i++) {
+      uint32_t u = zigzag(res[offset + i]);
+      uint32_t q = u >> k;
+      if (q < ESCAPE_QUOTIENT) {
+        writer.writeZeros(q);
+        writer.write(1, 1);
+        writer.write(u, k);
+      } else {
+        writer.writeZeros(ESCAPE_QUOTIENT);
+        writer.write(1, 1);
+        writer.write(u, 32);
+      }
+    }
+  }
+}
+
+static bool readRice(BitReader &reader, int32_t *res, int count) {
+  for (int offset = 0; offset < count; offset += BLOCK_SIZE) {
+    int blockLength = std::min(BLOCK_SIZE, count - offset);
+    int k = reader.read(5);
+    for (int i = 0; i < blockLength; i++) {
+      uint32_t q = reader.readUnary(ESCAPE_QUOTIENT);
+      uint32_t u = q < ESCAPE_QUOTIENT ? (q << k) | reader.read(k) : reader.read(32);
+      res[offset + i] = unzigzag(u);
+    }
+    if (reader.overrun) { return false; }
+  }
+  return true;
+}
+
+static void transpose(const int32_t *in, int32_t *out, int rows, int cols) {
+  for (int r = 0; r < rows; r++) {
+    for (int c = 0; c < cols; c++) {
+      out[c * rows + r] = in[r * cols + c];
+    }
+  }
+}
+
+bool encodeWavetable(Wavetable *wt, std::vector<uint8_t> &out) {
+  int frames = wt->n_data_tables;
+  int samples = wt->size;
+  if (frames <= 0 || samples <= 0) { return false; }
+  int count = frames * samples;
+  bool isFloat = !(wt->flags & wtf_int16);
+
+  std::vector<float> levelZero(count);
+  for (int f = 0; f < frames; f++) {
+    wt->ReadFrame(0, f, &levelZero[f * samples]);
+  }
+
+  float peak = 0.f;
+  if (isFloat) {
+    for (int i = 0; i < count; i++) {
+      peak = std::max(peak, std::fabs(levelZero[i]));
+    }
+  }
+  float scale = peak > 0.f ? peak : 1.f;
+
+  // Frame-major integer samples, exact for int16 sources
+  std::vector<int32_t> byFrames(count);
+  for (int f = 0; f < frames; f++) {
+    const float *frame = &levelZero[f * samples];
+    for (int i = 0; i < samples; i++) {
+      byFrames[f * samples + i] = isFloat ?
+        (int32_t)std::lrint(frame[i] / scale * FLOAT_RANGE) :
+        (int32_t)std::lrint(frame[i] * 16384.f);
+    }
+  }
+  std::vector<int32_t> bySamples(count);
+  transpose(byFrames.data(), bySamples.data(), frames, samples);
+
+  std::vector<int32_t> residual(count);
+  uint64_t bestCost = UINT64_MAX;
+  bool bestAcrossFrames = false;
+  int bestOrder = 0;
+  for (int acrossFrames = 0; acrossFrames < 2; acrossFrames++) {
+    for (int order = 0; order < 4; order++) {
+      if (acrossFrames) {
+        differentiate(byFrames.data(), residual.data(), frames, samples, order);
+      } else {
+        differentiate(bySamples.data(), residual.data(), samples, frames, order);
+      }
+      uint64_t cost = riceCost(residual.data(), count);
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestAcrossFrames = acrossFrames;
+        bestOrder = order;
+      }
+    }
+  }
+  if (bestAcrossFrames) {
+    differentiate(byFrames.data(), residual.data(), frames, samples, bestOrder);
+  } else {
+    differentiate(bySamples.data(), residual.data(), samples, frames, bestOrder);
+  }
+
+  uint8_t codecFlags = bestOrder << CODEC_ORDER_SHIFT;
+  if (isFloat) { codecFlags |= CODEC_FLOAT24; }
+  if (bestAcrossFrames) { codecFlags |= CODEC_ACROSS_FRAMES; }
+  if (wt->n_tables != frames) { codecFlags |= CODEC_APPEND_SILENCE; }
+
+  out.clear();
+  out.reserve(HEADER_SIZE + bestCost / 8 + 1);
+  out.resize(HEADER_SIZE);
+  memcpy(out.data(), "ZWTC", 4);
+  out[4] = CODEC_VERSION;
+  out[5] = codecFlags;
+  putU16(&out[6], wt->flags);
+  putU32(&out[8], samples);
+  putU16(&out[12], frames);
+  putU16(&out[14], wt->n_rows);
+  uint32_t scaleBits;
+  memcpy(&scaleBits, &scale, sizeof(float));
+  putU32(&out[16], scaleBits);
+
+  BitWriter writer(out);
+  writeRice(writer, residual.data(), count);
+  putU32(&out[20], (out.size() - HEADER_SIZE) * 8 + writer.bits);
+  writer.flush();
+  return true;
+}
+
+bool decodeWavetable(const uint8_t *data, size_t size, Wavetable *wt, bool buildMipmaps) {
+  int headerSize = size > 4 && data[4] == 1 ? 20 : HEADER_SIZE;
+  if (size < (size_t)headerSize || memcmp(data, "ZWTC", 4) != 0 || data[4] < 1 || data[4] > CODEC_VERSION) {
+    std::cout << "Embedded wavetable has unknown format" << std::endl;
+    return false;
+  }
+  uint8_t codecFlags = data[5];
+  int flags = getU16(data + 6);
+  int samples = getU32(data + 8);
+  int frames = getU16(data + 12);
+  int rows = std::max(1, (int)getU16(data + 14)); // 0 before grids
+  float scale;
+  uint32_t scaleBits = getU32(data + 16);
+  memcpy(&scale, &scaleBits, sizeof(float));
+
+  // Patches are untrusted, the padding frames and all the mipmaps have to fit
+  int tables = frames + ((codecFlags & CODEC_APPEND_SILENCE) ? 3 : 0);
+  if (samples <= 0 || samples > max_wtable_size || frames <= 0 || tables > MaxWTFrames(samples) || frames % rows != 0) {
+    std::cout << "Embedded wavetable has invalid dimensions " << samples << " x " << frames << std::endl;
+    return false;
+  }
+  int count = frames * samples;
+  bool acrossFrames = codecFlags & CODEC_ACROSS_FRAMES;
+  int order = (codecFlags >> CODEC_ORDER_SHIFT) & 3;
+
+  // The reader pads with zeros past the end, only the stored length tells a cut payload apart
+  uint64_t payloadBits = (uint64_t)(size - headerSize) * 8;
+  uint64_t expectedBits = headerSize >= 24 ? getU32(data + 20) : payloadBits;
+  if (expectedBits > payloadBits) {
+    std::cout << "Embedded wavetable data is truncated" << std::endl;
+    return false;
+  }
+
+  std::vector<int32_t> values(count);
+  BitReader reader(data + headerSize, data + size);
+  if (!readRice(reader, values.data(), count) || (headerSize >= 24 && reader.position != expectedBits)) {
+    std::cout << "Embedded wavetable data is truncated or corrupt" << std::endl;
+    return false;
+  }
+
+  // Residuals are laid out so that the predictor recurrence runs along rows
+  if (acrossFrames) {
+    integrate(values.data(), frames, samples, order);
+  } else {
+    integrate(values.data(), samples, frames, order);
+  }
+
+  wt_header wh;
+  memset(&wh, 0, sizeof(wt_header));
+  wh.n_samples = samples;
+  wh.n_tables = frames;
+
+  bool built;
+  if (codecFlags & CODEC_FLOAT24) {
+    std::vector<float> pcm(count);
+    float gain = scale / FLOAT_RANGE;
+    for (int f = 0; f < frames; f++) {
+      for (int i = 0; i < samples; i++) {
+        int32_t v = acrossFrames ? values[f * samples + i] : values[i * frames + f];
+        pcm[f * samples + i] = (float)v * gain;
+      }
+    }
+    wh.flags = flags & ~(wtf_int16 | wtf_int16_is_16);
+    built = wt->BuildWT(pcm.data(), wh, codecFlags & CODEC_APPEND_SILENCE, buildMipmaps);
+  } else {
+    std::vector<short> pcm(count);
+    for (int f = 0; f < frames; f++) {
+      for (int i = 0; i < samples; i++) {
+        int32_t v = acrossFrames ? values[f * samples + i] : values[i * frames + f];
+        pcm[f * samples + i] = (short)v;
+      }
+    }
+    wh.flags = (flags | wtf_int16) & ~wtf_int16_is_16;
+    built = wt->BuildWT(pcm.data(), wh, codecFlags & CODEC_APPEND_SILENCE, buildMipmaps);
+  }
+  if (built) {
+    wt->n_rows = rows;
+  }
+  return built;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Wavetable.hpp"
+
+/*
+ * Compact serialization of the level-0 frames of a Wavetable, used to embed
+ * tables into patches. Samples are quantized to integers (exactly for int16
+ * sources, 24 bit relative to the peak for float sources), decorrelated with a
+ * fixed polynomial predictor running either along samples or across frames and
+ * Rice coded per frame.
+ */
+
+bool encodeWavetable(Wavetable *wt, std::vector<uint8_t> &out);
+
+// Mipmaps may be skipped and built later with Wavetable::MipMapWT()
+bool decodeWavetable(const uint8_t *data, size_t size, Wavetable *wt, bool buildMipmaps = true);
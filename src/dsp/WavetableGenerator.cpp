@@ -0,0 +1,428 @@
+#include "WavetableGenerator.hpp"
+#include "FFT.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <memory>
+
+static int mipmapLevels(int size) {
+  // Same count as Wavetable::MipMapWT
+  int levels = 1;
+  while (((1 << levels) < size) & (levels < max_mipmap_levels)) { levels++; }
+  return levels;
+}
+
+/*
+ * Fills the spectrum of a real frame so that the inverse transform yields
+ * sum(a * sin(2 pi n x + phase)). Two frames are rendered per transform: the
+ * first one lands in the real part and the second one in the imaginary part.
+ */
+static void addSpectrum(std::complex<float> *bins, int size, const HarmonicFrame &frame, bool imaginary) {
+  int harmonics = std::min((int)frame.amplitudes.size(), size / 2 - 1);
+  std::complex<float> unit = imaginary ? std::complex<float>(0.f, 1.f) : std::complex<float>(1.f, 0.f);
+  for (int n = 1; n <= harmonics; n++) {
+    float amplitude = frame.amplitudes[n - 1];
+    if (amplitude == 0.f) { continue; }
+    float phase = n - 1 < (int)frame.phases.size() ? frame.phases[n - 1] : 0.f;
+    std::complex<float> bin = std::polar(0.5f * amplitude, phase) * std::complex<float>(0.f, -1.f);
+    bins[n] += unit * bin;
+    bins[size - n] += unit * std::conj(bin);
+  }
+}
+
+bool generateWavetable(Wavetable *wt, const std::vector<HarmonicFrame> &frames, int size, bool normalize) {
+  int tables = frames.size();
+  if (tables < 1 || tables > max_subtables || size < 2 || size > max_wtable_size || (size & (size - 1))) {
+    return false;
+  }
+
+  int levels = mipmapLevels(size);
+  std::vector<std::vector<float>> data(levels);
+  std::vector<std::complex<float>> bins(size);
+
+  for (int l = 0; l < levels; l++) {
+    int lsize = size >> l;
+    FFT fft(lsize);
+    data[l].resize((size_t)tables * lsize);
+    for (int j = 0; j < tables; j += 2) {
+      std::fill(bins.begin(), bins.begin() + lsize, std::complex<float>(0.f, 0.f));
+      addSpectrum(bins.data(), lsize, frames[j], false);
+      if (j + 1 < tables) {
+        addSpectrum(bins.data(), lsize, frames[j + 1], true);
+      }
+      fft.inverse(bins.data());
+      float *first = &data[l][(size_t)j * lsize];
+      for (int i = 0; i < lsize; i++) {
+        first[i] = bins[i].real();
+      }
+      if (j + 1 < tables) {
+        float *second = first + lsize;
+        for (int i = 0; i < lsize; i++) {
+          second[i] = bins[i].imag();
+        }
+      }
+    }
+  }
+
+  float peak = 0.f;
+  for (float value : data[0]) {
+    peak = std::max(peak, std::fabs(value));
+  }
+  float scale = (normalize && peak > 0.f) ? 1.f / peak : 1.f;
+  std::vector<float *> pointers(levels);
+  for (int l = 0; l < levels; l++) {
+    for (float &value : data[l]) {
+      value = std::max(-1.f, std::min(1.f, value * scale));
+    }
+    pointers[l] = data[l].data();
+  }
+  return wt->BuildWTFromMipmaps(size, tables, pointers.data());
+}
+
+// Reads the harmonics of a single frame back, the inverse of addSpectrum
+static void analyzeFrame(const FFT &fft, const float *samples, std::complex<float> *bins, HarmonicFrame &frame) {
+  int size = fft.size;
+  for (int i = 0; i < size; i++) {
+    bins[i] = std::complex<float>(samples[i], 0.f);
+  }
+  fft.forward(bins);
+  int harmonics = size / 2 - 1;
+  frame.amplitudes.resize(harmonics);
+  frame.phases.resize(harmonics);
+  for (int n = 1; n <= harmonics; n++) {
+    std::complex<float> bin = bins[n] * std::complex<float>(0.f, 2.f / size);
+    frame.amplitudes[n - 1] = std::abs(bin);
+    frame.phases[n - 1] = std::arg(bin);
+  }
+}
+
+bool interpolateFrames(Wavetable *src, int framesCount, std::vector<HarmonicFrame> &frames) {
+  int tables = src->n_tables;
+  int size = src->size;
+  if (tables < 2 || framesCount < 2 || framesCount > max_subtables || size < 4 || (size & (size - 1))) {
+    return false;
+  }
+
+  FFT fft(size);
+  std::vector<std::complex<float>> bins(size);
+  std::vector<HarmonicFrame> sources(tables);
+  std::vector<float> frame(size);
+  for (int j = 0; j < tables; j++) {
+    src->ReadFrame(0, j, frame.data());
+    analyzeFrame(fft, frame.data(), bins.data(), sources[j]);
+  }
+
+  const float pi = 3.14159265358979f;
+  // Below this a harmonic is treated as absent and takes the phase of the other side
+  const float silence = 1e-6f;
+  frames.resize(framesCount);
+  for (int i = 0; i < framesCount; i++) {
+    float position = (float)i * (tables - 1) / (framesCount - 1);
+    int j0 = std::min((int)position, tables - 2);
+    float t = position - j0;
+    const HarmonicFrame &a = sources[j0];
+    const HarmonicFrame &b = sources[j0 + 1];
+    HarmonicFrame &frame = frames[i];
+    int harmonics = a.amplitudes.size();
+    frame.amplitudes.resize(harmonics);
+    frame.phases.resize(harmonics);
+    for (int n = 0; n < harmonics; n++) {
+      frame.amplitudes[n] = a.amplitudes[n] + (b.amplitudes[n] - a.amplitudes[n]) * t;
+      if (a.amplitudes[n] < silence) {
+        frame.phases[n] = b.phases[n];
+      } else if (b.amplitudes[n] < silence) {
+        frame.phases[n] = a.phases[n];
+      } else {
+        // Shortest way round, so a half-cycle turn never passes through zero
+        float delta = b.phases[n] - a.phases[n];
+        delta -= 2.f * pi * std::floor((delta + pi) / (2.f * pi));
+        frame.phases[n] = a.phases[n] + delta * t;
+      }
+    }
+  }
+  return true;
+}
+
+/*
+ * Formula expressions are parsed once into a small tree and evaluated for
+ * every harmonic of every frame.
+ */
+
+struct Expression {
+  enum Kind { NUMBER, VARIABLE, UNARY, BINARY, FUNCTION };
+  Kind kind = NUMBER;
+  double value = 0.0;
+  char op = 0; // variable name, operator, or function index
+  std::unique_ptr<Expression> left;
+  std::unique_ptr<Expression> right;
+  int height = 1; // evaluated recursively, so bounded by the parser
+
+  double evaluate(const double *variables) const {
+    switch (this->kind) {
+      case NUMBER: return this->value;
+      case VARIABLE: return variables[(int)this->op];
+      case UNARY: return -this->left->evaluate(variables);
+      case FUNCTION: {
+        double x = this->left->evaluate(variables);
+        switch (this->op) {
+          case 0: return sin(x);
+          case 1: return cos(x);
+          case 2: return tan(x);
+          case 3: return exp(x);
+          case 4: return log(x);
+          case 5: return sqrt(x);
+          case 6: return fabs(x);
+          default: return floor(x);
+        }
+      }
+      case BINARY: {
+        double a = this->left->evaluate(variables);
+        double b = this->right->evaluate(variables);
+        switch (this->op) {
+          case '+': return a + b;
+          case '-': return a - b;
+          case '*': return a * b;
+          case '/': return b != 0.0 ? a / b : 0.0;
+          case '%': return b != 0.0 ? fmod(a, b) : 0.0;
+          default: return pow(a, b);
+        }
+      }
+    }
+    return 0.0;
+  }
+};
+
+static const char *functionNames[] = { "sin", "cos", "tan", "exp", "log", "sqrt", "abs", "floor" };
+static const char *variableNames[] = { "n", "t", "f" };
+
+struct ExpressionParser {
+  // Formulas come with patches, so nesting is limited to keep the recursion off the end of the stack
+  static const int maxDepth = 256;
+
+  const std::string &text;
+  size_t pos = 0;
+  int depth = 0;
+  std::string error;
+
+  ExpressionParser(const std::string &text) : text(text) {}
+
+  void skipSpaces() {
+    while (this->pos < this->text.size() && isspace((unsigned char)this->text[this->pos])) { this->pos++; }
+  }
+
+  bool accept(char c) {
+    this->skipSpaces();
+    if (this->pos < this->text.size() && this->text[this->pos] == c) {
+      this->pos++;
+      return true;
+    }
+    return false;
+  }
+
+  std::unique_ptr<Expression> fail(std::string message) {
+    if (this->error.empty()) {
+      this->error = message + " at position " + std::to_string(this->pos + 1);
+    }
+    return nullptr;
+  }
+
+  std::unique_ptr<Expression> binary(char op, std::unique_ptr<Expression> left, std::unique_ptr<Expression> right) {
+    if (!left || !right) { return nullptr; }
+    int height = std::max(left->height, right->height) + 1;
+    if (height > maxDepth) {
+      return this->fail("Formula nested too deeply");
+    }
+    std::unique_ptr<Expression> node(new Expression);
+    node->kind = Expression::BINARY;
+    node->op = op;
+    node->height = height;
+    node->left = std::move(left);
+    node->right = std::move(right);
+    return node;
+  }
+
+  // sum := product (('+' | '-') product)*
+  std::unique_ptr<Expression> parseSum() {
+    std::unique_ptr<Expression> node = this->parseProduct();
+    while (node) {
+      if (this->accept('+')) {
+        node = this->binary('+', std::move(node), this->parseProduct());
+      } else if (this->accept('-')) {
+        node = this->binary('-', std::move(node), this->parseProduct());
+      } else {
+        break;
+      }
+    }
+    return node;
+  }
+
+  // product := unary (('*' | '/' | '%') unary)*
+  std::unique_ptr<Expression> parseProduct() {
+    std::unique_ptr<Expression> node = this->parseUnary();
+    while (node) {
+      char op = 0;
+      if (this->accept('*')) {
+        op = '*';
+      } else if (this->accept('/')) {
+        op = '/';
+      } else if (this->accept('%')) {
+        op = '%';
+      } else {
+        break;
+      }
+      node = this->binary(op, std::move(node), this->parseUnary());
+    }
+    return node;
+  }
+
+  // unary := '-' unary | power
+  // Every recursion of the grammar passes through here, so this is where the depth is counted
+  std::unique_ptr<Expression> parseUnary() {
+    if (this->depth >= maxDepth) {
+      return this->fail("Formula nested too deeply");
+    }
+    this->depth++;
+    std::unique_ptr<Expression> node;
+    if (this->accept('-')) {
+      std::unique_ptr<Expression> operand = this->parseUnary();
+      if (operand) {
+        node.reset(new Expression);
+        node->kind = Expression::UNARY;
+        node->height = operand->height + 1;
+        node->left = std::move(operand);
+      }
+    } else if (this->accept('+')) {
+      node = this->parseUnary();
+    } else {
+      node = this->parsePower();
+    }
+    this->depth--;
+    return node;
+  }
+
+  // power := atom ('^' unary)?
+  std::unique_ptr<Expression> parsePower() {
+    std::unique_ptr<Expression> node = this->parseAtom();
+    if (node && this->accept('^')) {
+      node = this->binary('^', std::move(node), this->parseUnary());
+    }
+    return node;
+  }
+
+  std::unique_ptr<Expression> parseAtom() {
+    this->skipSpaces();
+    if (this->pos >= this->text.size()) {
+      return this->fail("Unexpected end");
+    }
+    if (this->accept('(')) {
+      std::unique_ptr<Expression> node = this->parseSum();
+      if (node && !this->accept(')')) {
+        return this->fail("Missing ')'");
+      }
+      return node;
+    }
+
+    const char *start = this->text.c_str() + this->pos;
+    if (isdigit((unsigned char)*start) || *start == '.') {
+      char *end;
+      std::unique_ptr<Expression> node(new Expression);
+      node->value = strtod(start, &end);
+      this->pos += end - start;
+      return node;
+    }
+
+    if (!isalpha((unsigned char)*start)) {
+      return this->fail(std::string("Unexpected '") + *start + "'");
+    }
+    size_t length = 0;
+    while (isalnum((unsigned char)start[length])) { length++; }
+    std::string name(start, length);
+    this->pos += length;
+
+    if (name == "pi") {
+      std::unique_ptr<Expression> node(new Expression);
+      node->value = M_PI;
+      return node;
+    }
+    for (int i = 0; i < 3; i++) {
+      if (name == variableNames[i]) {
+        std::unique_ptr<Expression> node(new Expression);
+        node->kind = Expression::VARIABLE;
+        node->op = i;
+        return node;
+      }
+    }
+    for (int i = 0; i < 8; i++) {
+      if (name == functionNames[i]) {
+        if (!this->accept('(')) {
+          return this->fail("Missing '(' after " + name);
+        }
+        std::unique_ptr<Expression> argument = this->parseSum();
+        if (!argument) { return nullptr; }
+        if (!this->accept(')')) {
+          return this->fail("Missing ')'");
+        }
+        std::unique_ptr<Expression> node(new Expression);
+        node->kind = Expression::FUNCTION;
+        node->op = i;
+        node->height = argument->height + 1;
+        node->left = std::move(argument);
+        return node;
+      }
+    }
+    return this->fail("Unknown name '" + name + "'");
+  }
+
+  std::unique_ptr<Expression> parse() {
+    std::unique_ptr<Expression> node = this->parseSum();
+    this->skipSpaces();
+    if (node && this->pos < this->text.size()) {
+      return this->fail(std::string("Unexpected '") + this->text[this->pos] + "'");
+    }
+    return node;
+  }
+};
+
+bool buildHarmonicFrames(const std::string &formula, int framesCount, int harmonics, std::vector<HarmonicFrame> &frames, std::string *error) {
+  size_t separator = formula.find(';');
+  std::string amplitudeText = formula.substr(0, separator);
+  std::string phaseText = separator != std::string::npos ? formula.substr(separator + 1) : "";
+
+  ExpressionParser amplitudeParser(amplitudeText);
+  std::unique_ptr<Expression> amplitude = amplitudeParser.parse();
+  if (!amplitude) {
+    if (error) { *error = amplitudeParser.error; }
+    return false;
+  }
+  std::unique_ptr<Expression> phase;
+  if (phaseText.find_first_not_of(" \t") != std::string::npos) {
+    ExpressionParser phaseParser(phaseText);
+    phase = phaseParser.parse();
+    if (!phase) {
+      if (error) { *error = "Phase: " + phaseParser.error; }
+      return false;
+    }
+  }
+
+  frames.assign(framesCount, HarmonicFrame());
+  double variables[3];
+  for (int f = 0; f < framesCount; f++) {
+    HarmonicFrame &frame = frames[f];
+    frame.amplitudes.resize(harmonics);
+    if (phase) { frame.phases.resize(harmonics); }
+    variables[1] = framesCount > 1 ? (double)f / (framesCount - 1) : 0.0;
+    variables[2] = f;
+    for (int n = 1; n <= harmonics; n++) {
+      variables[0] = n;
+      double value = amplitude->evaluate(variables);
+      frame.amplitudes[n - 1] = std::isfinite(value) ? value : 0.f;
+      if (phase) {
+        value = phase->evaluate(variables);
+        frame.phases[n - 1] = std::isfinite(value) ? value : 0.f;
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Wavetable.hpp"
+
+/*
+ * Additive wavetable synthesis. Each frame is a list of harmonic amplitudes
+ * and phases (index 0 is the fundamental); every mipmap level is rendered
+ * straight from it with an inverse FFT, keeping only the harmonics below the
+ * level's Nyquist, so no filtering pass is needed.
+ */
+
+struct HarmonicFrame {
+  std::vector<float> amplitudes;
+  std::vector<float> phases; // radians, may be shorter than amplitudes
+};
+
+bool generateWavetable(Wavetable *wt, const std::vector<HarmonicFrame> &frames, int size, bool normalize = true);
+
+/*
+ * Upsamples the frame axis of a wavetable: framesCount frames evenly spread
+ * over the frames of src, each harmonic morphing in magnitude and phase
+ * between the two nearest source frames. Unlike a crossfade this keeps the
+ * level of in-between frames where the source frames are out of phase. DC is
+ * dropped; render the result with generateWavetable(wt, frames, src->size, false).
+ */
+bool interpolateFrames(Wavetable *src, int framesCount, std::vector<HarmonicFrame> &frames);
+
+/*
+ * Harmonic recipes written as "amplitude" or "amplitude; phase" expressions of
+ * n (harmonic number from 1), t (frame position from 0 to 1), f (frame index)
+ * and pi, with + - * / % ^, parentheses and sin, cos, tan, exp, log, sqrt,
+ * abs, floor. E.g. "(1 - t * (1 - n % 2)) / n" morphs from saw to square.
+ */
+bool buildHarmonicFrames(const std::string &formula, int framesCount, int harmonics, std::vector<HarmonicFrame> &frames, std::string *error = nullptr);
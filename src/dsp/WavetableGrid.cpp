@@ -0,0 +1,48 @@
+#include "WavetableGrid.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+bool buildWavetableGrid(const std::vector<std::shared_ptr<Wavetable>> &rows, Wavetable *grid, ResampleQuality quality) {
+  int rowsCount = std::min((int)rows.size(), maxGridRows);
+  if (rowsCount < 1) { return false; }
+
+  int size = 0;
+  int columns = 0;
+  for (int r = 0; r < rowsCount; r++) {
+    size = std::max(size, rows[r]->size);
+    columns = std::max(columns, rows[r]->n_data_tables);
+  }
+  if (size < 2) { return false; }
+  columns = std::min(columns, MaxWTFrames(size) / rowsCount);
+  if (columns < 1) { return false; }
+
+  std::vector<float> data((size_t)rowsCount * columns * size);
+  for (int r = 0; r < rowsCount; r++) {
+    Wavetable *row = rows[r].get();
+    std::unique_ptr<FrameResampler> resampler;
+    if (row->size != size) {
+      resampler.reset(new FrameResampler(row->size, size, quality));
+    }
+    std::vector<float> source(row->size);
+    for (int c = 0; c < columns; c++) {
+      int frame = columns > 1 ? (int)std::round((double)c * (row->n_data_tables - 1) / (columns - 1)) : 0;
+      float *target = &data[((size_t)r * columns + c) * size];
+      if (resampler) {
+        row->ReadFrame(0, frame, source.data());
+        resampler->process(source.data(), target);
+      } else {
+        row->ReadFrame(0, frame, target);
+      }
+    }
+  }
+
+  wt_header wh;
+  memset(&wh, 0, sizeof(wt_header));
+  wh.n_samples = size;
+  wh.n_tables = rowsCount * columns;
+  wh.flags = 0;
+  if (!grid->BuildWT(data.data(), wh, false)) { return false; }
+  grid->n_rows = rowsCount;
+  return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "Wavetable.hpp"
+#include "FrameResampler.hpp"
+
+/*
+ * 2D wavetables: every source table becomes a row of one grid, so that the
+ * player can morph along the frames of a row with one index and across rows
+ * with another. Rows are brought to the longest frame size and the largest
+ * frame count of the set; shorter rows repeat their nearest frames.
+ */
+
+const int maxGridRows = 64;
+
+bool buildWavetableGrid(const std::vector<std::shared_ptr<Wavetable>> &rows, Wavetable *grid, ResampleQuality quality = RESAMPLE_HIGH);
@@ -0,0 +1,55 @@
+#include "WavetablePreview.hpp"
+#include <algorithm>
+#include <cstdint>
+
+std::vector<int> spreadFrames(int tables, int count) {
+  std::vector<int> frames;
+  if (tables < 1) { return frames; }
+  if (tables == 1) {
+    frames.push_back(0);
+    return frames;
+  }
+  count = std::max(2, std::min(tables, count));
+  for (int i = 0; i < count; i++) {
+    int frame = (int)((int64_t)i * (tables - 1) / (count - 1));
+    if (frames.empty() || frames.back() != frame) {
+      frames.push_back(frame);
+    }
+  }
+  return frames;
+}
+
+void decimateFrame(const float *data, int size, int columns, float *out) {
+  for (int column = 0; column < columns; column++) {
+    int begin = column * size / columns;
+    int end = std::max(begin + 1, (column + 1) * size / columns);
+    int minIdx = begin;
+    int maxIdx = begin;
+    for (int i = begin + 1; i < end; i++) {
+      if (data[i] < data[minIdx]) { minIdx = i; }
+      if (data[i] > data[maxIdx]) { maxIdx = i; }
+    }
+    *out++ = data[std::min(minIdx, maxIdx)];
+    *out++ = data[std::max(minIdx, maxIdx)];
+  }
+}
+
+std::shared_ptr<WavetablePreview> buildWavetablePreview(Wavetable *wt, int columns, int maxVertices) {
+  std::shared_ptr<WavetablePreview> preview = std::make_shared<WavetablePreview>();
+  if ((!wt->TableF32Data && !wt->TableF16Data) || wt->size < 2 || wt->n_tables < 1) { return preview; }
+
+  preview->size = wt->size;
+  preview->tables = wt->n_tables;
+  preview->rows = wt->n_rows;
+  preview->columns = std::max(1, std::min(columns, wt->size / 2));
+
+  preview->frames = spreadFrames(wt->n_tables, maxVertices / preview->pointsPerFrame());
+
+  preview->points.resize(preview->frames.size() * preview->pointsPerFrame());
+  std::vector<float> data(wt->size);
+  for (int idx = 0; idx < (int)preview->frames.size(); idx++) {
+    wt->ReadFrame(0, preview->frames[idx], data.data());
+    decimateFrame(data.data(), wt->size, preview->columns, preview->points.data() + idx * preview->pointsPerFrame());
+  }
+  return preview;
+}
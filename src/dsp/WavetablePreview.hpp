@@ -0,0 +1,38 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "Wavetable.hpp"
+
+/*
+ * Decimated outline of a Wavetable for the 3D display, built once per load
+ * off the UI thread. Every column of a frame keeps its min and max samples in
+ * the order they occur, and frames are skipped evenly so that the whole
+ * preview never exceeds maxVertices no matter how large the table is.
+ */
+struct WavetablePreview {
+  int size = 0;
+  int tables = 0;
+  int rows = 1; // of a grid, its frames are rows * (tables / rows)
+  int columns = 0;
+  std::vector<int> frames; // indices of the frames kept
+  std::vector<float> points; // 2 * columns values per kept frame
+
+  int pointsPerFrame() const {
+    return this->columns * 2;
+  }
+
+  const float *framePoints(int idx) const {
+    return this->points.data() + idx * this->pointsPerFrame();
+  }
+};
+
+const int previewColumns = 64;
+const int previewMaxVertices = 8192;
+
+// Up to count frame indices spread evenly from the first to the last frame
+std::vector<int> spreadFrames(int tables, int count);
+
+// Writes 2 * columns points: min and max of every column, in the order they occur
+void decimateFrame(const float *data, int size, int columns, float *out);
+
+std::shared_ptr<WavetablePreview> buildWavetablePreview(Wavetable *wt, int columns = previewColumns, int maxVertices = previewMaxVertices);
@@ -0,0 +1,325 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "Wavetable.hpp"
+#include "HalfFloat.hpp"
+#include "Oversampler.hpp"
+
+/*
+ * Per-sample table reads, kept free of Rack so that the benchmark runs the
+ * exact code the player does.
+ */
+
+inline float getWTSample(Wavetable *wt, int wave, float phase) {
+  int targetWaveSize = wt->size;
+
+  float intpart;
+  float fractpart = std::modf(phase * targetWaveSize, &intpart);
+
+  int index0 = intpart;
+  int index1 = index0 + 1 == targetWaveSize ? 0 : index0 + 1;
+
+  int waveOffset = targetWaveSize * wave;
+
+  float sample0, sample1;
+  if (wt->TableF16Data) {
+    sample0 = halfToFloat(wt->TableF16Data[waveOffset + index0]);
+    sample1 = halfToFloat(wt->TableF16Data[waveOffset + index1]);
+  } else {
+    sample0 = wt->TableF32Data[waveOffset + index0];
+    sample1 = wt->TableF32Data[waveOffset + index1];
+  }
+
+  return sample0 + (sample1 - sample0) * fractpart;
+}
+
+inline float getWTMipmapSample(Wavetable *wt, int mipmapLevel, int wave, float phase) {
+  int targetWaveSize = wt->size >> mipmapLevel;
+
+  float intpart;
+  float fractpart = std::modf(phase * targetWaveSize, &intpart);
+
+  int index0 = intpart;
+  int index1 = index0 + 1 == targetWaveSize ? 0 : index0 + 1;
+
+  float sample0, sample1;
+  if (wt->TableF16Data) {
+    sample0 = halfToFloat(wt->TableF16WeakPointers[mipmapLevel][wave][index0]);
+    sample1 = halfToFloat(wt->TableF16WeakPointers[mipmapLevel][wave][index1]);
+  } else {
+    sample0 = wt->TableF32WeakPointers[mipmapLevel][wave][index0];
+    sample1 = wt->TableF32WeakPointers[mipmapLevel][wave][index1];
+  }
+
+  return sample0 + (sample1 - sample0) * fractpart;
+}
+
+// Level whose frames still hold all harmonics below Nyquist at this pitch, and
+// the amount of the next (duller) level to blend in; -1 reads level 0 as is.
+inline int selectMipmapLevel(Wavetable *wt, float samplesPerCycle, float *mipmapInterpol) {
+  *mipmapInterpol = 0.f;
+  if (!(samplesPerCycle > 0.f)) { return -1; }
+  float idealSizePo2 = std::log2(samplesPerCycle);
+  float possibleSizePo2 = std::fmin(std::fmax(idealSizePo2, 3.f), (float)wt->size_po2);
+
+  float referenceMipmapLevel = (float)wt->size_po2 - possibleSizePo2;
+
+  float targetMipmapLevelFloat;
+  float interpol = std::modf(referenceMipmapLevel, &targetMipmapLevelFloat);
+  *mipmapInterpol = interpol * interpol;
+  return (int)targetMipmapLevelFloat;
+}
+
+inline float getWTFrameSample(Wavetable *wt, int wave, float phase, int mipmapLevel, float mipmapInterpol) {
+  if (mipmapLevel < 0) {
+    return getWTSample(wt, wave, phase);
+  }
+  float sample0 = getWTMipmapSample(wt, mipmapLevel, wave, phase);
+  float sample1 = getWTMipmapSample(wt, mipmapLevel + 1, wave, phase);
+  return sample0 + (sample1 - sample0) * mipmapInterpol;
+}
+
+/*
+ * Renders the player's output one sample at a time: picks the mipmap level
+ * for the current phase increment, crossfades neighbouring frames (or takes
+ * the nearest one) and optionally runs the read 2x or 4x oversampled. Tables
+ * with several rows are read as a grid: the index moves along a row, the Y
+ * index across rows, and the four surrounding frames are blended bilinearly.
+ */
+struct WavetableReader {
+  // Samples the index has to hold still for before its blended frame gets
+  // cached, long enough for the index oversampler to settle as well
+  static const int staticIndexDelay = 64;
+
+  Oversampler indexOversampler;
+  Oversampler indexYOversampler;
+  Oversampler outputOversampler;
+  float lastPhase = 0.f;
+  int indexIntpart = 0;
+  float interpolation = 0.f;
+  bool indexInterpolation = true; // off reads the nearest frame only
+
+  // Crossfade of the two frames around a static index, blended level by level
+  // on first use; level l starts at 2 * size - (2 * size >> l)
+  std::vector<float> blended = std::vector<float>(2 * max_wtable_size);
+  uint32_t blendedLevels = 0;
+  Wavetable *blendedWavetable = nullptr;
+  float staticIndex = -1.f;
+  float staticIndexY = -1.f;
+  int stableSamples = 0;
+
+  void invalidate() {
+    this->blendedLevels = 0;
+    this->stableSamples = 0;
+  }
+
+  void frameIndices(Wavetable *wt, float index, int *index0, int *index1, float *fractpart) {
+    float intpart;
+    *fractpart = std::modf(index * (wt->n_tables - 1), &intpart);
+    *index0 = intpart;
+    *index1 = *index0 + 1 >= wt->n_tables ? 0 : *index0 + 1;
+  }
+
+  // Four corners of the grid cell around (index, indexY) and their weights;
+  // frames are laid out row after row
+  void gridFrames(Wavetable *wt, float index, float indexY, int frames[4], float weights[4]) {
+    int columns = wt->n_tables / wt->n_rows;
+    float x = index * (columns - 1);
+    float y = indexY * (wt->n_rows - 1);
+    if (!this->indexInterpolation) {
+      x = std::round(x);
+      y = std::round(y);
+    }
+    float xIntpart, yIntpart;
+    float xFract = std::modf(x, &xIntpart);
+    float yFract = std::modf(y, &yIntpart);
+    int x0 = xIntpart;
+    int y0 = yIntpart;
+    int x1 = std::min(x0 + 1, columns - 1);
+    int y1 = std::min(y0 + 1, wt->n_rows - 1);
+    frames[0] = y0 * columns + x0;
+    frames[1] = y0 * columns + x1;
+    frames[2] = y1 * columns + x0;
+    frames[3] = y1 * columns + x1;
+    weights[0] = (1.f - xFract) * (1.f - yFract);
+    weights[1] = xFract * (1.f - yFract);
+    weights[2] = (1.f - xFract) * yFract;
+    weights[3] = xFract * yFract;
+    this->indexIntpart = frames[0];
+    this->interpolation = xFract;
+  }
+
+  float readGrid(Wavetable *wt, float index, float indexY, float phase, int mipmapLevel, float mipmapInterpol) {
+    int frames[4];
+    float weights[4];
+    this->gridFrames(wt, index, indexY, frames, weights);
+    // All four corners share one mipmap decision; kept as plain arrays so
+    // that the compiler can vectorize the blend
+    float samples[4];
+    for (int k = 0; k < 4; k++) {
+      samples[k] = getWTFrameSample(wt, frames[k], phase, mipmapLevel, mipmapInterpol);
+    }
+    float wave = 0.f;
+    for (int k = 0; k < 4; k++) {
+      wave += samples[k] * weights[k];
+    }
+    return wave;
+  }
+
+  float readFrames(Wavetable *wt, float index, float indexY, float phase, int mipmapLevel, float mipmapInterpol) {
+    if (wt->n_rows > 1) {
+      return this->readGrid(wt, index, indexY, phase, mipmapLevel, mipmapInterpol);
+    }
+    if (!this->indexInterpolation) {
+      this->indexIntpart = (int)std::round(index * (wt->n_tables - 1));
+      this->interpolation = 0.f;
+      return getWTFrameSample(wt, this->indexIntpart, phase, mipmapLevel, mipmapInterpol);
+    }
+
+    int index0, index1;
+    float fractpart;
+    this->frameIndices(wt, index, &index0, &index1, &fractpart);
+    this->indexIntpart = index0;
+    this->interpolation = fractpart;
+
+    float wave0 = getWTFrameSample(wt, index0, phase, mipmapLevel, mipmapInterpol);
+    float wave1 = getWTFrameSample(wt, index1, phase, mipmapLevel, mipmapInterpol);
+    return wave0 + (wave1 - wave0) * fractpart;
+  }
+
+  // True once the index has held still long enough to read the blended frame instead
+  bool updateStaticIndex(Wavetable *wt, float index, float indexY) {
+    if (index != this->staticIndex || indexY != this->staticIndexY || wt != this->blendedWavetable || !this->indexInterpolation) {
+      this->staticIndex = index;
+      this->staticIndexY = indexY;
+      this->blendedWavetable = wt;
+      this->invalidate();
+      return false;
+    }
+    if (this->stableSamples < staticIndexDelay) {
+      this->stableSamples++;
+      return false;
+    }
+    return true;
+  }
+
+  // Adds one frame of a level, scaled by weight, to out
+  void accumulateFrame(Wavetable *wt, int level, int frame, float weight, float *out) {
+    int lsize = wt->size >> level;
+    if (wt->TableF16Data) {
+      const uint16_t *wave = wt->TableF16WeakPointers[level][frame];
+      for (int i = 0; i < lsize; i++) {
+        out[i] += halfToFloat(wave[i]) * weight;
+      }
+    } else {
+      const float *wave = wt->TableF32WeakPointers[level][frame];
+      for (int i = 0; i < lsize; i++) {
+        out[i] += wave[i] * weight;
+      }
+    }
+  }
+
+  float *blendedLevel(Wavetable *wt, int level) {
+    int lsize = wt->size >> level;
+    float *out = &this->blended[2 * wt->size - (2 * wt->size >> level)];
+    if (this->blendedLevels & (1u << level)) { return out; }
+
+    std::fill(out, out + lsize, 0.f);
+    if (wt->n_rows > 1) {
+      int frames[4];
+      float weights[4];
+      this->gridFrames(wt, this->staticIndex, this->staticIndexY, frames, weights);
+      for (int k = 0; k < 4; k++) {
+        this->accumulateFrame(wt, level, frames[k], weights[k], out);
+      }
+    } else {
+      int index0, index1;
+      float fractpart;
+      this->frameIndices(wt, this->staticIndex, &index0, &index1, &fractpart);
+      this->accumulateFrame(wt, level, index0, 1.f - fractpart, out);
+      this->accumulateFrame(wt, level, index1, fractpart, out);
+    }
+    this->blendedLevels |= 1u << level;
+    return out;
+  }
+
+  float readBlendedLevel(Wavetable *wt, int level, float phase) {
+    int targetWaveSize = wt->size >> level;
+    const float *wave = this->blendedLevel(wt, level);
+
+    float intpart;
+    float fractpart = std::modf(phase * targetWaveSize, &intpart);
+
+    int index0 = intpart;
+    int index1 = index0 + 1 == targetWaveSize ? 0 : index0 + 1;
+
+    return wave[index0] + (wave[index1] - wave[index0]) * fractpart;
+  }
+
+  // Same result as readFrames() for the static index with half the table reads
+  float readBlended(Wavetable *wt, float phase, int mipmapLevel, float mipmapInterpol) {
+    if (mipmapLevel < 0) {
+      return this->readBlendedLevel(wt, 0, phase);
+    }
+    float sample0 = this->readBlendedLevel(wt, mipmapLevel, phase);
+    if (mipmapInterpol == 0.f) { return sample0; }
+    float sample1 = this->readBlendedLevel(wt, mipmapLevel + 1, phase);
+    return sample0 + (sample1 - sample0) * mipmapInterpol;
+  }
+
+  // index, indexY and phase are all within [0, 1); indexY only matters for
+  // grids. The phase increment is guessed from the last phase, taking the
+  // shortest way so that audio-rate PM going backwards does not sweep through
+  // a whole cycle.
+  float process(Wavetable *wt, float index, float indexY, float phase, bool useMipmaps, int factor) {
+    float phaseDelta = phase - this->lastPhase;
+    phaseDelta -= std::floor(phaseDelta);
+    float signedDelta = phaseDelta > 0.5f ? phaseDelta - 1.f : phaseDelta;
+    return this->process(wt, index, indexY, phase, signedDelta, useMipmaps, factor);
+  }
+
+  // Same, with the exact signed phase increment of this sample known
+  float process(Wavetable *wt, float index, float indexY, float phase, float phaseDelta, bool useMipmaps, int factor) {
+    this->indexOversampler.setFactor(factor);
+    this->indexYOversampler.setFactor(factor);
+    this->outputOversampler.setFactor(factor);
+    bool isStatic = this->updateStaticIndex(wt, index, indexY);
+
+    float wave;
+    if (factor == 1) {
+      float mipmapInterpol = 0.f;
+      int mipmapLevel = useMipmaps && phaseDelta != 0.f ? selectMipmapLevel(wt, 1.f / std::fabs(phaseDelta), &mipmapInterpol) : -1;
+      if (isStatic) {
+        wave = this->readBlended(wt, phase, mipmapLevel, mipmapInterpol);
+      } else {
+        wave = this->readFrames(wt, index, indexY, phase, mipmapLevel, mipmapInterpol);
+      }
+    } else {
+      float mipmapInterpol = 0.f;
+      int mipmapLevel = useMipmaps && phaseDelta != 0.f ? selectMipmapLevel(wt, factor / std::fabs(phaseDelta), &mipmapInterpol) : -1;
+
+      float indices[Oversampler::MAX_FACTOR];
+      float indicesY[Oversampler::MAX_FACTOR];
+      float waves[Oversampler::MAX_FACTOR];
+      // Still fed while static, so that their history is current once the index moves
+      this->indexOversampler.upsample(index, indices);
+      this->indexYOversampler.upsample(indexY, indicesY);
+      for (int i = 0; i < factor; i++) {
+        float subPhase = phase - phaseDelta * (factor - 1 - i) / factor;
+        subPhase -= std::floor(subPhase);
+        if (isStatic) {
+          waves[i] = this->readBlended(wt, subPhase, mipmapLevel, mipmapInterpol);
+        } else {
+          float subIndex = std::fmin(std::fmax(indices[i], 0.f), 1.f);
+          float subIndexY = std::fmin(std::fmax(indicesY[i], 0.f), 1.f);
+          waves[i] = this->readFrames(wt, subIndex, subIndexY, subPhase, mipmapLevel, mipmapInterpol);
+        }
+      }
+      wave = this->outputOversampler.downsample(waves);
+    }
+
+    this->lastPhase = phase;
+    return wave;
+  }
+};
@@ -0,0 +1,139 @@
+#include "WavetableSlicer.hpp"
+#include "FFT.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Longest stretch of audio the period is estimated from, taken from the middle
+static const int analysisLength = 1 << 16;
+// Lags whose correlation gets this close to the best one count as the period, so
+// that the shortest of several multiples of the period wins
+static const float octaveTolerance = 0.9f;
+static const float minCorrelation = 0.5f;
+
+// Parabolic fit through a correlation peak and its neighbours
+static float peakLag(const std::vector<float> &correlation, int lag) {
+  float a = correlation[lag - 1];
+  float b = correlation[lag];
+  float c = correlation[lag + 1];
+  float denominator = a - 2.f * b + c;
+  float offset = denominator != 0.f ? 0.5f * (a - c) / denominator : 0.f;
+  return lag + std::max(-0.5f, std::min(0.5f, offset));
+}
+
+float detectPeriod(const float *samples, int count, int minPeriod, int maxPeriod) {
+  int length = std::min(count, analysisLength);
+  const float *window = samples + (count - length) / 2;
+  maxPeriod = std::min(maxPeriod, length / 2);
+  if (minPeriod < 2 || maxPeriod <= minPeriod) { return 0.f; }
+
+  float mean = 0.f;
+  for (int i = 0; i < length; i++) {
+    mean += window[i];
+  }
+  mean /= length;
+
+  // Zero padded to twice the length, so the circular correlation does not wrap
+  int size = 1;
+  while (size < length * 2) { size <<= 1; }
+  FFT fft(size);
+  std::vector<std::complex<float>> bins(size, std::complex<float>(0.f, 0.f));
+  for (int i = 0; i < length; i++) {
+    bins[i] = std::complex<float>(window[i] - mean, 0.f);
+  }
+  fft.forward(bins.data());
+  for (int i = 0; i < size; i++) {
+    bins[i] = std::complex<float>(std::norm(bins[i]), 0.f);
+  }
+  fft.inverse(bins.data());
+
+  float energy = bins[0].real();
+  if (!(energy > 0.f)) { return 0.f; }
+  // Unbiased, so that longer lags are not penalized for overlapping less
+  int maxLag = length / 2;
+  std::vector<float> correlation(maxLag + 2);
+  for (int lag = 0; lag < maxLag + 2; lag++) {
+    correlation[lag] = bins[lag].real() / energy * length / (length - lag);
+  }
+
+  // Skips the lobe around lag 0
+  int first = minPeriod;
+  while (first < maxPeriod && correlation[first] > 0.f) { first++; }
+  float best = 0.f;
+  for (int lag = first; lag <= maxPeriod; lag++) {
+    best = std::max(best, correlation[lag]);
+  }
+  if (best < minCorrelation) { return 0.f; }
+
+  for (int lag = first; lag <= maxPeriod; lag++) {
+    bool isPeak = correlation[lag] >= correlation[lag - 1] && correlation[lag] >= correlation[lag + 1];
+    if (isPeak && correlation[lag] >= best * octaveTolerance) {
+      float period = peakLag(correlation, lag);
+      // Peaks at multiples of the period pin it down finer, each one close to where the last estimate puts it
+      for (int multiple = 2; multiple * period < maxLag / 2; multiple *= 2) {
+        int around = (int)std::round(multiple * period);
+        int peak = around;
+        for (int l = around - 2; l <= around + 2; l++) {
+          if (correlation[l] > correlation[peak]) { peak = l; }
+        }
+        period = peakLag(correlation, peak) / multiple;
+      }
+      return period;
+    }
+  }
+  return 0.f;
+}
+
+static float cubicSample(const float *samples, int count, double position) {
+  int i = (int)std::floor(position);
+  float t = (float)(position - i);
+  float y0 = samples[std::max(0, std::min(count - 1, i - 1))];
+  float y1 = samples[std::max(0, std::min(count - 1, i))];
+  float y2 = samples[std::max(0, std::min(count - 1, i + 1))];
+  float y3 = samples[std::max(0, std::min(count - 1, i + 2))];
+  // Catmull-Rom
+  return y1 + 0.5f * t * (y2 - y0 + t * (2.f * y0 - 5.f * y1 + 4.f * y2 - y3 + t * (3.f * (y1 - y2) + y3 - y0)));
+}
+
+bool sliceWavetable(const float *samples, int count, Wavetable *wt, std::function<void(float)> progress, std::string *error) {
+  if (progress) { progress(0.f); }
+  float period = detectPeriod(samples, count, 8, max_wtable_size);
+  if (period == 0.f) {
+    if (error) { *error = "no stable pitch found"; }
+    return false;
+  }
+  if (progress) { progress(0.2f); }
+
+  // Cycles start on a rising zero crossing, so that the frames loop cleanly
+  int start = 0;
+  while (start < count - 1 && !(samples[start] <= 0.f && samples[start + 1] > 0.f)) { start++; }
+  if (start >= count - 1) { start = 0; }
+  int cycles = (int)((count - 1 - start) / period);
+  if (cycles < 1) {
+    if (error) { *error = "audio is shorter than a cycle"; }
+    return false;
+  }
+
+  int frameSize = period <= 2048.f ? 2048 : max_wtable_size;
+  int frames = std::min(cycles, MaxWTFrames(frameSize));
+  std::vector<float> data((size_t)frames * frameSize);
+  for (int f = 0; f < frames; f++) {
+    int cycle = frames > 1 ? (int)std::round((double)f * (cycles - 1) / (frames - 1)) : 0;
+    double cycleStart = start + cycle * (double)period;
+    float *frame = &data[(size_t)f * frameSize];
+    for (int i = 0; i < frameSize; i++) {
+      frame[i] = cubicSample(samples, count, cycleStart + (double)i * period / frameSize);
+    }
+    if (progress && (f & 15) == 15) { progress(0.2f + 0.6f * f / frames); }
+  }
+
+  wt_header wh;
+  memset(&wh, 0, sizeof(wt_header));
+  wh.n_samples = frameSize;
+  wh.n_tables = frames;
+  wh.flags = 0;
+  bool built = wt->BuildWT(data.data(), wh, false);
+  if (progress) { progress(1.f); }
+  if (!built && error) { *error = "wavetable could not be built"; }
+  return built;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <functional>
+#include <string>
+#include "Wavetable.hpp"
+
+/*
+ * Turns a plain recording of a pitched sound into a wavetable: the period is
+ * found by autocorrelation, then single cycles are cut out pitch-synchronously
+ * and each one is resampled to a power-of-two frame.
+ */
+
+// Fractional period in samples within [minPeriod, maxPeriod], or 0 when the audio is not periodic enough
+float detectPeriod(const float *samples, int count, int minPeriod, int maxPeriod);
+
+bool sliceWavetable(const float *samples, int count, Wavetable *wt, std::function<void(float)> progress = nullptr, std::string *error = nullptr);
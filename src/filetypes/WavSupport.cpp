@@ -26,6 +26,8 @@
 
 #include "WavSupport.hpp"
 #include "../dsp/Wavetable.hpp"
+#include "../dsp/WavetableBank.hpp"
+#include "../dsp/WavetableSlicer.hpp"
 
 #include <mutex>
 #include <iostream>
@@ -60,10 +62,12 @@ bool SurgeStorage::load_wt(std::string filename, Wavetable *wt)
         loaded = load_wt_wt(filename, wt);
     else if (extension.compare(".wav") == 0)
         loaded = load_wt_wav_portable(filename, wt);
+    else if (extension.compare(".zwt") == 0)
+        loaded = loadWavetableBank(filename, wt);
     else
     {
         std::cout << "Unable to load file with extension " << extension
-            << "! Surge only supports .wav and .wt wavetable files!" << std::endl;
+            << "! Only .wav, .wt and pre-baked .zwt wavetable files are supported!" << std::endl;
     }
     return loaded;
 }
@@ -97,9 +101,7 @@ bool SurgeStorage::load_wt_wt(std::string filename, Wavetable *wt)
     read = fread(data, 1, ds, f);
     // FIXME - error if read != ds
 
-    waveTableDataMutex.lock();
-    bool wasBuilt = wt->BuildWT(data, wh, false);
-    waveTableDataMutex.unlock();
+    bool wasBuilt = build_wt(wt, data, wh, false);
     free(data);
 
     if (!wasBuilt)
@@ -156,9 +158,9 @@ bool SurgeStorage::load_wt_wav_portable(std::string fn, Wavetable *wt)
     }
 
     // WAV HEADER
-    unsigned short audioFormat, numChannels;
+    unsigned short audioFormat = 0, numChannels = 0;
     unsigned int sampleRate __attribute__((unused)), byteRate __attribute__((unused));
-    unsigned short blockAlign __attribute__((unused)), bitsPerSample;
+    unsigned short blockAlign __attribute__((unused)), bitsPerSample = 0;
 
     // Result of data read
     bool hasSMPL = false;
@@ -327,7 +329,8 @@ bool SurgeStorage::load_wt_wav_portable(std::string fn, Wavetable *wt)
         else if (four_chars(chunkType, 'd', 'a', 't', 'a'))
         {
             datasz = cs;
-            datasamples = cs * 8 / bitsPerSample / numChannels;
+            // A data chunk ahead of the fmt chunk has no known sample format
+            datasamples = bitsPerSample && numChannels ? cs * 8 / bitsPerSample / numChannels : 0;
             wavdata = data;
         }
         else if (four_chars(chunkType, 's', 'm', 'p', 'l'))
@@ -392,7 +395,7 @@ bool SurgeStorage::load_wt_wav_portable(std::string fn, Wavetable *wt)
     std::cout << "  hasSRGE=" << hasSRGE << "/" << srgeLEN << std::endl;
 #endif
 
-    bool loopData = hasSMPL || hasCLM || hasSRGE;
+    bool loopData = hasSMPL || hasCLM || hasCUE || hasSRGE;
     int loopLen =
         hasCLM ? clmLEN : (hasCUE ? cueLEN : (hasSRGE ? srgeLEN : (hasSMPL ? smplLEN : -1)));
     if (loopLen == 0)
@@ -469,10 +472,15 @@ bool SurgeStorage::load_wt_wav_portable(std::string fn, Wavetable *wt)
         }
     }
 
-    if (loopLen != -1 && (sh == 0 || loopCount < 2))
+    // Other loop lengths get resampled to a power of two when building
+    bool resample = loopData && sh == 0 && loopLen >= 2 && loopLen <= 2 * max_wtable_size;
+    if (resample)
+        wh.flags = 0;
+
+    if (loopLen != -1 && ((sh == 0 && !resample) || loopCount < 2))
     {
-        std::cout << "Currently, Surge only supports wavetables with at least 2 frames of up to 4096 "
-               "samples each in power-of-two increments."
+        std::cout << "Currently, Surge only supports wavetables with at least 2 frames of 2 to "
+               "8192 samples each."
             << " You provided a wavetable with " << loopCount
             << (loopCount == 1 ? " frame" : " frames") << " of " << loopLen << " samples. '" << fn
             << "'" << std::endl;
@@ -482,10 +490,10 @@ bool SurgeStorage::load_wt_wav_portable(std::string fn, Wavetable *wt)
         return false;
     }
 
-    wh.n_samples = 1 << sh;
+    wh.n_samples = resample ? loopLen : 1 << sh;
     int mask __attribute__((unused)) = wt->size - 1;
     int sample_length = std::min(datasamples, max_wtable_size * max_subtables);
-    wh.n_tables = std::min(max_subtables, (sample_length >> sh));
+    wh.n_tables = std::min(max_subtables, sample_length / (int)wh.n_samples);
 
     if (wh.flags & wtf_is_sample)
     {
@@ -523,12 +531,90 @@ bool SurgeStorage::load_wt_wav_portable(std::string fn, Wavetable *wt)
         return false;
     }
 
-    if (wavdata && wt)
+    if (!loopData && slicePlainWav && wavdata && wt)
     {
+        std::vector<float> samples(datasamples);
+        if (wh.flags & wtf_int16)
+        {
+            for (int i = 0; i < datasamples; i++)
+                samples[i] = ((short *)wavdata)[i] / 32768.f;
+        }
+        else
+        {
+            memcpy(samples.data(), wavdata, datasamples * sizeof(float));
+        }
+
+        std::string error;
         waveTableDataMutex.lock();
-        wt->BuildWT(wavdata, wh, wh.flags & wtf_is_sample);
+        bool sliced = sliceWavetable(samples.data(), datasamples, wt, progress, &error);
         waveTableDataMutex.unlock();
+        if (sliced)
+        {
+            free(wavdata);
+            return true;
+        }
+        std::cout << "Could not slice '" << fn << "' by pitch (" << error
+            << "), loading it as a sample instead." << std::endl;
+    }
+
+    if (wavdata && wt)
+    {
+        bool built = build_wt(wt, wavdata, wh, wh.flags & wtf_is_sample);
         free(wavdata);
+        return built;
     }
     return true;
 }
+
+// Mipmapping works on power-of-two frames only, other sizes are resampled to the closest one
+bool SurgeStorage::build_wt(Wavetable *wt, void *data, wt_header &wh, bool AppendSilence)
+{
+    int n_samples = vt_read_int32LE(wh.n_samples);
+    int n_tables = vt_read_int16LE(wh.n_tables);
+    int flags = vt_read_int16LE(wh.flags);
+    if (n_samples >= 2 && !(n_samples & (n_samples - 1)))
+    {
+        std::lock_guard<std::mutex> lock(waveTableDataMutex);
+        if (!wt->BuildWT(data, wh, AppendSilence, !fastMipmaps))
+            return false;
+        if (fastMipmaps)
+            wt->MipMapWT(true);
+        return true;
+    }
+    if (n_samples < 2 || n_tables < 1)
+        return false;
+
+    int size = nearestPowerOfTwo(n_samples, max_wtable_size);
+    std::cout << "Resampling " << n_tables << " frames of " << n_samples << " samples to " << size
+              << std::endl;
+
+    // Same scaling as BuildWT applies to int16 data
+    float scale = (flags & wtf_int16_is_16) ? 1.f / 32768.f : 1.f / 16384.f;
+    std::vector<float> frame(n_samples);
+    std::vector<float> resampled((size_t)size * n_tables);
+    FrameResampler resampler(n_samples, size, resampleQuality);
+    for (int j = 0; j < n_tables; j++)
+    {
+        if (flags & wtf_int16)
+        {
+            const short *src = (const short *)data + (size_t)j * n_samples;
+            for (int i = 0; i < n_samples; i++)
+                frame[i] = vt_read_int16LE(src[i]) * scale;
+        }
+        else
+        {
+            memcpy(frame.data(), (const float *)data + (size_t)j * n_samples, n_samples * sizeof(float));
+        }
+        resampler.process(frame.data(), &resampled[(size_t)j * size]);
+    }
+
+    wt_header rh = wh;
+    rh.n_samples = size;
+    rh.flags = flags & ~(wtf_int16 | wtf_int16_is_16);
+    std::lock_guard<std::mutex> lock(waveTableDataMutex);
+    if (!wt->BuildWT(resampled.data(), rh, AppendSilence, !fastMipmaps))
+        return false;
+    if (fastMipmaps)
+        wt->MipMapWT(true);
+    return true;
+}
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "../dsp/Wavetable.hpp"
+#include "../dsp/FrameResampler.hpp"
 
 #include <mutex>
 #include <iostream>
@@ -13,6 +14,7 @@
 #include <cerrno>
 #include <cstring>
 #include <vector>
+#include <functional>
 
 unsigned int pl_int(char *d);
 
@@ -36,7 +38,17 @@ struct FcloseGuard
 struct SurgeStorage {
     std::mutex waveTableDataMutex;
 
+    // Plain .wav files (no clm, cue, smpl or srge chunk) are sliced into single
+    // cycles by pitch instead of being loaded as a sample
+    bool slicePlainWav = false;
+    std::function<void(float)> progress;
+    // For frames that are not a power of two long
+    ResampleQuality resampleQuality = RESAMPLE_HIGH;
+    // Builds quick preview mipmaps, see Wavetable::MipMapWT
+    bool fastMipmaps = false;
+
     bool load_wt(std::string filename, Wavetable *wt);
     bool load_wt_wt(std::string filename, Wavetable *wt);
     bool load_wt_wav_portable(std::string fn, Wavetable *wt);
+    bool build_wt(Wavetable *wt, void *data, wt_header &wh, bool AppendSilence);
 };
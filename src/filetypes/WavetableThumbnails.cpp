@@ -0,0 +1,380 @@
+#include "WavetableThumbnails.hpp"
+#include "../dsp/WavetableBank.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <sys/stat.h>
+
+#if ARCH_WIN
+#include <windows.h>
+#endif
+
+static const char thumbnailCacheTag[4] = { 'Z', 'W', 'T', 'T' };
+static const uint32_t thumbnailCacheVersion = 2; // 1 cached no thumbnail for loop lengths other than powers of two
+
+static std::string lowerExtension(const std::string &path) {
+  size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos) { return ""; }
+  std::string extension = path.substr(dot);
+  for (char &c : extension) { c = tolower(c); }
+  return extension;
+}
+
+bool isWavetableFilename(const std::string &path) {
+  std::string extension = lowerExtension(path);
+  return extension == ".wav" || extension == ".wt" || extension == ".zwt";
+}
+
+static FILE *openFile(const std::string &path, const char *mode) {
+#if ARCH_WIN
+  int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+  std::vector<wchar_t> widePath(length);
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, widePath.data(), length);
+  std::vector<wchar_t> wideMode(mode, mode + strlen(mode) + 1);
+  return _wfopen(widePath.data(), wideMode.data());
+#else
+  return fopen(path.c_str(), mode);
+#endif
+}
+
+bool statWavetableFile(const std::string &path, uint64_t &fileSize, int64_t &modified) {
+#if ARCH_WIN
+  int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+  std::vector<wchar_t> widePath(length);
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, widePath.data(), length);
+  struct _stat64 st;
+  if (_wstat64(widePath.data(), &st) != 0) { return false; }
+#else
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) { return false; }
+#endif
+  fileSize = st.st_size;
+  modified = st.st_mtime;
+  return true;
+}
+
+static uint32_t le32(const uint8_t *d) {
+  return d[0] | (d[1] << 8) | (d[2] << 16) | ((uint32_t)d[3] << 24);
+}
+
+static uint16_t le16(const uint8_t *d) {
+  return d[0] | (d[1] << 8);
+}
+
+/*
+ * Where the level-0 frames of a file are, mirroring how SurgeStorage lays
+ * them out when loading it for real.
+ */
+struct ThumbnailSource {
+  long dataOffset = 0;
+  int sampleBytes = 0; // 2 for int16, 4 for float
+  int frameSize = 0;
+  int tables = 0;
+};
+
+static bool locateWav(FILE *f, ThumbnailSource &src) {
+  uint8_t riff[12];
+  if (fread(riff, 1, 12, f) != 12 || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+
+  int audioFormat = 0, channels = 0, bits = 0;
+  bool hasClm = false, hasCue = false, hasSrge = false, hasSrgo = false, hasSmpl = false;
+  int clmLen = 0, cueLen = 0, srgeLen = 0, smplLen = 0;
+  long dataOffset = -1;
+  uint32_t dataSize = 0;
+
+  uint8_t chunk[8];
+  while (fread(chunk, 1, 8, f) == 8) {
+    uint32_t size = le32(chunk + 4);
+    long next = ftell(f) + (long)size;
+    std::vector<uint8_t> body;
+    bool isData = memcmp(chunk, "data", 4) == 0;
+    // Only small metadata chunks are read, sample data is skipped over
+    if (!isData && size <= (1 << 20)) {
+      body.resize(size);
+      if (fread(body.data(), 1, size, f) != size) { break; }
+    }
+
+    if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+      audioFormat = le16(&body[0]);
+      channels = le16(&body[2]);
+      bits = le16(&body[14]);
+    } else if (memcmp(chunk, "clm ", 4) == 0 && size >= 7) {
+      if (memcmp(&body[3], "2048", 4) == 0) {
+        hasClm = true;
+        clmLen = 2048;
+      }
+    } else if (memcmp(chunk, "uhWT", 4) == 0) {
+      hasClm = true;
+      clmLen = 2048;
+    } else if ((memcmp(chunk, "srge", 4) == 0 || memcmp(chunk, "srgo", 4) == 0) && size >= 8) {
+      hasSrge = true;
+      hasSrgo = chunk[3] == 'o';
+      srgeLen = le32(&body[4]);
+    } else if (memcmp(chunk, "cue ", 4) == 0 && size >= 4) {
+      uint32_t count = le32(&body[0]);
+      std::vector<int> starts;
+      for (uint32_t i = 0; i < count && 4 + (i + 1) * 24 <= size; i++) {
+        starts.push_back(le32(&body[4 + i * 24 + 20]));
+      }
+      int d = -1;
+      bool regular = true;
+      for (size_t i = 1; i < starts.size(); i++) {
+        if (d == -1) {
+          d = starts[i] - starts[i - 1];
+        } else if (d != starts[i] - starts[i - 1]) {
+          regular = false;
+        }
+      }
+      if (regular) {
+        hasCue = true;
+        cueLen = d;
+      }
+    } else if (memcmp(chunk, "smpl", 4) == 0 && size >= 36) {
+      uint32_t loops = le32(&body[28]);
+      if (loops == 0) {
+        hasSmpl = true;
+        smplLen = 2048;
+      } else if (size >= 60) {
+        hasSmpl = true;
+        smplLen = le32(&body[36 + 12]) - le32(&body[36 + 8]) + 1;
+        if (smplLen == 0) { smplLen = 2048; }
+      }
+    } else if (isData) {
+      dataOffset = ftell(f);
+      dataSize = size;
+    }
+    if (fseek(f, next + (size & 1), SEEK_SET) != 0) { break; }
+  }
+
+  if (dataOffset < 0 || channels != 1) { return false; }
+  if (audioFormat == 1 && bits == 16) {
+    src.sampleBytes = 2;
+  } else if (audioFormat == 3 && bits == 32) {
+    src.sampleBytes = 4;
+  } else {
+    return false;
+  }
+
+  int samples = dataSize / src.sampleBytes;
+  bool loopData = hasSmpl || hasClm || hasCue || hasSrge;
+  int loopLen = hasClm ? clmLen : (hasCue ? cueLen : (hasSrge ? srgeLen : (hasSmpl ? smplLen : -1)));
+  int sampleLength = std::min(samples, max_wtable_size * max_subtables);
+  // Same range as the loader, which resamples other lengths than powers of two; drawn before resampling
+  bool loadable = loopLen >= 2 && loopLen <= 2 * max_wtable_size;
+
+  if (loopData && loadable) {
+    src.frameSize = loopLen;
+    src.tables = std::min(max_subtables, sampleLength / loopLen);
+    if (samples / loopLen < 2) { return false; }
+  } else if (loopLen == -1) {
+    int windowSize = hasSrgo ? srgeLen : 1024;
+    while (windowSize * 4 > sampleLength && windowSize > 8) {
+      windowSize /= 2;
+    }
+    src.frameSize = windowSize;
+    src.tables = windowSize > 0 ? sampleLength / windowSize : 0;
+  } else {
+    return false;
+  }
+  src.dataOffset = dataOffset;
+  return src.frameSize > 0 && src.tables > 0;
+}
+
+static bool locateWt(FILE *f, ThumbnailSource &src) {
+  uint8_t header[12];
+  if (fread(header, 1, 12, f) != 12 || memcmp(header, "vawt", 4) != 0) { return false; }
+  src.frameSize = le32(header + 4);
+  src.tables = le16(header + 8);
+  src.sampleBytes = (le16(header + 10) & wtf_int16) ? 2 : 4;
+  src.dataOffset = 12;
+  return src.frameSize > 0 && src.frameSize <= max_wtable_size && src.tables > 0;
+}
+
+static bool locateBank(FILE *f, ThumbnailSource &src) {
+  wt_bank_header header;
+  if (fread(&header, sizeof(wt_bank_header), 1, f) != 1 || memcmp(header.tag, "ZWTB", 4) != 0) { return false; }
+  if (header.version != wt_bank_version || header.size == 0 || header.size > (uint32_t)max_wtable_size) { return false; }
+  src.frameSize = header.size;
+  src.tables = header.n_tables;
+  src.sampleBytes = 4;
+  src.dataOffset = header.f32_offset;
+  return src.tables > 0;
+}
+
+std::shared_ptr<WavetablePreview> extractWavetableThumbnail(const std::string &path, int frames, int columns) {
+  FILE *f = openFile(path, "rb");
+  if (!f) { return nullptr; }
+
+  ThumbnailSource src;
+  std::string extension = lowerExtension(path);
+  bool located = extension == ".wav" ? locateWav(f, src) : (extension == ".wt" ? locateWt(f, src) : (extension == ".zwt" ? locateBank(f, src) : false));
+  if (!located) {
+    fclose(f);
+    return nullptr;
+  }
+
+  std::shared_ptr<WavetablePreview> thumbnail = std::make_shared<WavetablePreview>();
+  thumbnail->size = src.frameSize;
+  thumbnail->tables = src.tables;
+  thumbnail->columns = std::max(1, std::min(columns, src.frameSize / 2));
+  thumbnail->frames = spreadFrames(src.tables, frames);
+  thumbnail->points.resize(thumbnail->frames.size() * thumbnail->pointsPerFrame());
+
+  std::vector<uint8_t> raw(src.frameSize * src.sampleBytes);
+  std::vector<float> samples(src.frameSize);
+  for (int idx = 0; idx < (int)thumbnail->frames.size(); idx++) {
+    long offset = src.dataOffset + (long)thumbnail->frames[idx] * src.frameSize * src.sampleBytes;
+    if (fseek(f, offset, SEEK_SET) != 0 || fread(raw.data(), 1, raw.size(), f) != raw.size()) {
+      fclose(f);
+      return nullptr;
+    }
+    for (int i = 0; i < src.frameSize; i++) {
+      if (src.sampleBytes == 2) {
+        samples[i] = (int16_t)le16(&raw[i * 2]) / 32768.f;
+      } else {
+        float value;
+        memcpy(&value, &raw[i * 4], 4);
+        samples[i] = std::isfinite(value) ? value : 0.f;
+      }
+    }
+    decimateFrame(samples.data(), src.frameSize, thumbnail->columns, thumbnail->points.data() + idx * thumbnail->pointsPerFrame());
+  }
+  fclose(f);
+
+  float peak = 0.f;
+  for (float point : thumbnail->points) {
+    peak = std::max(peak, std::fabs(point));
+  }
+  if (peak > 0.f) {
+    for (float &point : thumbnail->points) {
+      point /= peak;
+    }
+  }
+  return thumbnail;
+}
+
+std::shared_ptr<const WavetablePreview> WavetableThumbnailCache::find(const std::string &path) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  std::map<std::string, Entry>::iterator it = this->entries.find(path);
+  return it != this->entries.end() ? it->second.thumbnail : nullptr;
+}
+
+std::shared_ptr<const WavetablePreview> WavetableThumbnailCache::update(const std::string &path) {
+  uint64_t fileSize;
+  int64_t modified;
+  if (!statWavetableFile(path, fileSize, modified)) { return nullptr; }
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::map<std::string, Entry>::iterator it = this->entries.find(path);
+    if (it != this->entries.end() && it->second.fileSize == fileSize && it->second.modified == modified) {
+      return it->second.thumbnail;
+    }
+  }
+  Entry entry;
+  entry.fileSize = fileSize;
+  entry.modified = modified;
+  entry.thumbnail = extractWavetableThumbnail(path);
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->entries[path] = entry;
+  this->dirty = true;
+  return entry.thumbnail;
+}
+
+/*
+ * Cache file: tag, version, entries count, then per entry the path, file
+ * size and mtime, the preview dimensions, its frame indices and its points.
+ */
+
+template <typename T>
+static bool readValue(FILE *f, T &value) {
+  return fread(&value, sizeof(T), 1, f) == 1;
+}
+
+template <typename T>
+static void writeValue(FILE *f, const T &value) {
+  fwrite(&value, sizeof(T), 1, f);
+}
+
+void WavetableThumbnailCache::load(const std::string &path) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (this->loaded) { return; }
+  this->loaded = true;
+  this->cachePath = path;
+
+  FILE *f = openFile(path, "rb");
+  if (!f) { return; }
+  char tag[4];
+  uint32_t version = 0, count = 0;
+  if (fread(tag, 1, 4, f) != 4 || memcmp(tag, thumbnailCacheTag, 4) != 0 ||
+      !readValue(f, version) || version != thumbnailCacheVersion || !readValue(f, count)) {
+    fclose(f);
+    return;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t pathLength, framesCount, pointsCount;
+    int32_t size, tables, columns;
+    Entry entry;
+    if (!readValue(f, pathLength) || pathLength > 4096) { break; }
+    std::string entryPath(pathLength, '\0');
+    if (fread(&entryPath[0], 1, pathLength, f) != pathLength) { break; }
+    if (!readValue(f, entry.fileSize) || !readValue(f, entry.modified)) { break; }
+    if (!readValue(f, size) || !readValue(f, tables) || !readValue(f, columns)) { break; }
+    if (!readValue(f, framesCount) || !readValue(f, pointsCount)) { break; }
+    if (framesCount > (uint32_t)max_subtables || pointsCount != framesCount * columns * 2) { break; }
+    if (size > 0) {
+      std::shared_ptr<WavetablePreview> thumbnail = std::make_shared<WavetablePreview>();
+      thumbnail->size = size;
+      thumbnail->tables = tables;
+      thumbnail->columns = columns;
+      thumbnail->frames.resize(framesCount);
+      thumbnail->points.resize(pointsCount);
+      if (fread(thumbnail->frames.data(), sizeof(int), framesCount, f) != framesCount) { break; }
+      if (fread(thumbnail->points.data(), sizeof(float), pointsCount, f) != pointsCount) { break; }
+      entry.thumbnail = thumbnail;
+    }
+    this->entries[entryPath] = entry;
+  }
+  fclose(f);
+}
+
+void WavetableThumbnailCache::save() {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (!this->dirty || this->cachePath.empty()) { return; }
+
+  std::string tmpPath = this->cachePath + ".tmp";
+  FILE *f = openFile(tmpPath, "wb");
+  if (!f) { return; }
+  fwrite(thumbnailCacheTag, 1, 4, f);
+  writeValue(f, thumbnailCacheVersion);
+  writeValue(f, (uint32_t)this->entries.size());
+  for (std::map<std::string, Entry>::iterator it = this->entries.begin(); it != this->entries.end(); ++it) {
+    const Entry &entry = it->second;
+    const WavetablePreview *thumbnail = entry.thumbnail.get();
+    writeValue(f, (uint32_t)it->first.size());
+    fwrite(it->first.data(), 1, it->first.size(), f);
+    writeValue(f, entry.fileSize);
+    writeValue(f, entry.modified);
+    writeValue(f, (int32_t)(thumbnail ? thumbnail->size : 0));
+    writeValue(f, (int32_t)(thumbnail ? thumbnail->tables : 0));
+    writeValue(f, (int32_t)(thumbnail ? thumbnail->columns : 0));
+    writeValue(f, (uint32_t)(thumbnail ? thumbnail->frames.size() : 0));
+    writeValue(f, (uint32_t)(thumbnail ? thumbnail->points.size() : 0));
+    if (thumbnail) {
+      fwrite(thumbnail->frames.data(), sizeof(int), thumbnail->frames.size(), f);
+      fwrite(thumbnail->points.data(), sizeof(float), thumbnail->points.size(), f);
+    }
+  }
+  bool written = !ferror(f);
+  written = (fclose(f) == 0) && written;
+  if (written) {
+    remove(this->cachePath.c_str());
+    written = rename(tmpPath.c_str(), this->cachePath.c_str()) == 0;
+  }
+  if (written) {
+    this->dirty = false;
+  }
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "../dsp/WavetablePreview.hpp"
+
+/*
+ * Small previews of wavetable files for browsing. They are read straight from
+ * the file header and a few frames of sample data, without building the table,
+ * and kept in a disk cache keyed by path, size and modification time.
+ */
+
+const int thumbnailFrames = 6;
+const int thumbnailColumns = 24;
+
+bool isWavetableFilename(const std::string &path);
+bool statWavetableFile(const std::string &path, uint64_t &fileSize, int64_t &modified);
+std::shared_ptr<WavetablePreview> extractWavetableThumbnail(const std::string &path, int frames = thumbnailFrames, int columns = thumbnailColumns);
+
+struct WavetableThumbnailCache {
+  struct Entry {
+    uint64_t fileSize = 0;
+    int64_t modified = 0;
+    std::shared_ptr<const WavetablePreview> thumbnail; // empty for unreadable files
+  };
+
+  std::mutex mutex;
+  std::map<std::string, Entry> entries;
+  std::string cachePath;
+  bool loaded = false;
+  bool dirty = false;
+
+  // Cheap lookup for the UI, does not touch the file
+  std::shared_ptr<const WavetablePreview> find(const std::string &path);
+  // Returns the cached thumbnail or extracts a new one if the file has changed
+  std::shared_ptr<const WavetablePreview> update(const std::string &path);
+
+  void load(const std::string &path);
+  void save();
+};
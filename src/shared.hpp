@@ -1,5 +1,6 @@
 #include "math.hpp"
 #include "dsp/digital.hpp"
+#include "FixedPointPhase.hpp"
 
 #ifndef ZZC_SHARED_H
 #define ZZC_SHARED_H
@@ -21,12 +22,8 @@ struct TPulseGenerator {
   }
 };
 
-struct LowFrequencyOscillator {
-  float phase = 0.0f;
-  float lastPhase = 0.0f;
-  float freq = 1.0f;
-  float freqCorrection = 0.0f;
-
+// Follows an external clock by bending the tempo of the fixed-point phase
+struct LowFrequencyOscillator : FixedPointPhase {
   int PPQN = 1;
 
   dsp::SchmittTrigger clockTrigger;
@@ -38,65 +35,185 @@ struct LowFrequencyOscillator {
 
   LowFrequencyOscillator() {}
 
-  void setPitch(float pitch) {
-    freq = pitch;
+  void adjustPhase(float pulse) {
+    if (!this->clockTrigger.process(pulse)) { return; }
+    if (this->phaseAccumulator == 0) {
+      this->freqCorrection = 0.0;
+      return;
+    }
+    double segmentLength = 1.0 / this->PPQN;
+    double absoluteSegmentPhase = std::fmod(std::ldexp((double)this->phaseAccumulator, -64), segmentLength);
+    double scaledPhase = absoluteSegmentPhase * this->PPQN;
+    double deviation = scaledPhase - (scaledPhase < 0.5 ? 0.0 : 1.0);
+    this->freqCorrection = -std::abs(this->freq) * deviation;
   }
+};
+
+/*
+ * Independent tempo lanes, one per channel of a polyphonic V/BPS input, run in
+ * float_4 batches. Each lane keeps the same 64-bit fixed-point phase as
+ * LowFrequencyOscillator, advanced one lane at a time as there are no 64-bit
+ * integer vectors, and only converts its tempo to an increment when it changes.
+ */
+struct ClockLanes {
+  static const int maxLanes = 16;
+
+  uint64_t accumulators[maxLanes] = {};
+  int64_t increments[maxLanes] = {};
+  float incrementBpms[maxLanes] = {}; // the increments were computed for
+  double incrementSampleTime = 0.0;
+  float phases[maxLanes] = {};
+
+  simd::float_4 phase[4] = {0.f};
+  TPulseGenerator<simd::float_4> pulseGenerators[4];
 
   void reset(float value) {
-    this->phase = std::fmod(value, 1.0f);
-    this->freqCorrection = 0.0f;
+    uint64_t accumulator = LowFrequencyOscillator::phaseToAccumulator(value);
+    for (int i = 0; i < maxLanes; i++) {
+      this->accumulators[i] = accumulator;
+      this->phases[i] = LowFrequencyOscillator::accumulatorToPhase(accumulator);
+    }
+    for (int c = 0; c < maxLanes; c += 4) {
+      this->phase[c / 4] = simd::float_4::load(&this->phases[c]);
+      this->pulseGenerators[c / 4].trigger(simd::float_4::mask());
+    }
   }
 
-  bool step(float dt) {
-    float deltaPhase = (freq + this->freqCorrection) * dt;
-    float summ = phase + deltaPhase;
-    this->lastPhase = this->phase;
-    this->phase = rack::math::eucMod(summ, 1.0f);
-    bool flipped = freq >= 0.0f ? summ >= 1.0f : summ < 0.0f;
-    return flipped;
+  // Lanes patched in later start where the main oscillator is, as separate clocks would have kept running
+  void join(int from, int to, uint64_t accumulator) {
+    for (int i = from; i < to; i++) {
+      this->accumulators[i] = accumulator;
+      this->phases[i] = LowFrequencyOscillator::accumulatorToPhase(accumulator);
+    }
+    for (int c = from / 4 * 4; c < to; c += 4) {
+      this->phase[c / 4] = simd::float_4::load(&this->phases[c]);
+    }
   }
 
-  void adjustPhase(float pulse) {
-    if (!this->clockTrigger.process(pulse)) { return; }
-    if (phase == 0.0f) {
-      this->freqCorrection = 0.0f;
-      return;
+  // A negative tempo runs the lane backwards; wraps trigger the pulse generators
+  void step(const simd::float_4 *bpm, int channels, double dt) {
+    if (dt != this->incrementSampleTime) {
+      this->incrementSampleTime = dt;
+      std::fill(this->incrementBpms, this->incrementBpms + maxLanes, NAN);
+    }
+    for (int i = 0; i < channels; i++) {
+      float laneBpm = bpm[i / 4][i % 4];
+      if (laneBpm != this->incrementBpms[i]) {
+        this->incrementBpms[i] = laneBpm;
+        this->increments[i] = LowFrequencyOscillator::cyclesToIncrement(laneBpm / 60.0 * dt);
+      }
+      this->accumulators[i] += (uint64_t)this->increments[i];
+      this->phases[i] = LowFrequencyOscillator::accumulatorToPhase(this->accumulators[i]);
+    }
+    for (int c = 0; c < channels; c += 4) {
+      simd::float_4 lastPhase = this->phase[c / 4];
+      simd::float_4 newPhase = simd::float_4::load(&this->phases[c]);
+      simd::float_4 forward = bpm[c / 4] >= 0.f;
+      simd::float_4 flipped = simd::ifelse(forward, newPhase < lastPhase, newPhase > lastPhase);
+      this->pulseGenerators[c / 4].trigger(flipped);
+      this->phase[c / 4] = newPhase;
     }
-    float segmentLength = 1.0f / this->PPQN;
-    float absoluteSegmentPhase = std::fmod(this->phase, segmentLength);
-    float scaledPhase = absoluteSegmentPhase * this->PPQN;
-    float deviation = scaledPhase - (scaledPhase < 0.5f ? 0.0f : 1.0f);
-    this->freqCorrection = -std::abs(this->freq) * deviation;
   }
 };
 
+/*
+ * Follows an external clock with a second-order delay-locked loop: every pulse
+ * is compared with the time it was predicted for, and the error pulls both the
+ * next prediction and the period. The loop starts out wide and narrows to the
+ * set bandwidth over lockPulses pulses, by when it is locked. Pulses outside
+ * the window around the prediction are skipped as outliers, and a missing one
+ * is bridged by the prediction; after several outliers in a row the next
+ * pulse starts over as a first one, and the tempo is acquired afresh from
+ * the interval after it.
+ */
 struct ClockTracker {
-  int triggersPassed;
-  float period;
+  static const int lockPulses = 8;
+  static const int maxOutliers = 3;
+  static constexpr double window = 0.25; // of the period, each way
+  static constexpr double acquireBandwidth = 0.15;
+
   float freq;
   bool freqDetected;
+  bool locked;
+  float jitter; // RMS deviation of the pulses from the loop, in seconds
+  double bandwidth = 0.05; // in cycles per pulse once locked
+
+  double time;
+  double lastPulse;
+  double predicted; // time of the next pulse
+  double period;
+  double errorSquares;
+  int pulses;
+  int outliers;
 
   dsp::SchmittTrigger clockTrigger;
 
   void init() {
-    triggersPassed = 0;
-    period = 0.0f;
     freq = 0.0f;
     freqDetected = false;
+    locked = false;
+    jitter = 0.0f;
+    time = 0.0;
+    lastPulse = -1.0;
+    predicted = 0.0;
+    period = 0.0;
+    errorSquares = 0.0;
+    pulses = 0;
+    outliers = 0;
   }
 
-  void process(float dt, float pulse) {
-    period += dt;
-    if (clockTrigger.process(pulse)) {
-      if (triggersPassed < 3) {
-        triggersPassed += 1;
-      }
-      if (triggersPassed > 2) {
-        freqDetected = true;
-        freq = 1.0f / period;
-      }
-      period = 0.0f;
+  void acquire(double interval) {
+    period = interval;
+    predicted = time + interval;
+    errorSquares = 0.0;
+    pulses = 1;
+    outliers = 0;
+    locked = false;
+    freq = 1.0 / interval;
+    freqDetected = true;
+  }
+
+  // Takes the sample time as 1.0 / sampleRate, see LowFrequencyOscillator::step
+  void process(double dt, float pulse) {
+    time += dt;
+    if (period > 0.0 && time > predicted + window * period) {
+      predicted += period;
+      if (++outliers >= maxOutliers) { locked = false; }
+    }
+    if (!clockTrigger.process(pulse)) { return; }
+
+    double interval = time - lastPulse;
+    bool first = lastPulse < 0.0;
+    lastPulse = time;
+    if (first || interval <= 0.0) { return; }
+    // After a stop or a run of dropped pulses the interval spans the gap, so this counts as a first pulse
+    if (outliers >= maxOutliers) {
+      period = 0.0;
+      outliers = 0;
+      locked = false;
+      return;
+    }
+    if (period == 0.0) {
+      acquire(interval);
+      return;
+    }
+    double error = time - predicted;
+    if (std::abs(error) > window * period) {
+      outliers++;
+      return;
     }
+
+    outliers = 0;
+    pulses++;
+    double progress = std::min((double)pulses / lockPulses, 1.0);
+    double omega = 2.0 * M_PI * (acquireBandwidth + (bandwidth - acquireBandwidth) * progress);
+    predicted += std::sqrt(2.0) * omega * error + period;
+    period = std::max(period + omega * omega * error, 1e-4);
+    errorSquares += (error * error - errorSquares) * 0.1;
+
+    freq = 1.0 / period;
+    jitter = std::sqrt(errorSquares);
+    locked = pulses >= lockPulses;
   }
 };
 
@@ -0,0 +1,73 @@
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "FixedPointPhase.hpp"
+
+/*
+ * Runs the Clock's fixed-point phase for 24 hours of samples at the common
+ * sample rates, stepped the way Clock steps it, and checks that it does not
+ * drift: the wraps counted plus the final accumulator must add up to exactly
+ * one increment per sample, and that must stay within the rounding of the
+ * increment of the ideal bpm / 60 cycles per second.
+ *
+ *   clockdrift [--hours h]
+ */
+
+typedef unsigned __int128 uint128_t;
+
+static const float sampleRates[] = { 44100.f, 48000.f, 96000.f };
+static const double tempos[] = { 120.0, 127.0, 33.3, -90.0 };
+
+static bool run(float sampleRate, double bpm, double hours) {
+  FixedPointPhase oscillator;
+  oscillator.setPitch(bpm / 60.0);
+  double dt = 1.0 / sampleRate;
+  uint64_t samples = (uint64_t)std::llround(sampleRate * hours * 3600.0);
+  int64_t beats = 0;
+  for (uint64_t i = 0; i < samples; i++) {
+    if (oscillator.step(dt)) {
+      beats += bpm >= 0.0 ? 1 : -1;
+    }
+  }
+
+  // Both sides in units of 2^-64 cycles, offset by whole cycles so that reverse runs stay positive
+  int64_t increment = oscillator.phaseIncrement(dt);
+  uint128_t offset = (uint128_t)(std::abs(beats) + 1) << 64;
+  uint128_t counted = offset + ((uint128_t)(__int128)beats << 64) + oscillator.phaseAccumulator;
+  uint128_t stepped = offset + (uint128_t)((__int128)increment * (__int128)samples);
+  bool exact = counted == stepped && oscillator.phase == FixedPointPhase::accumulatorToPhase(oscillator.phaseAccumulator);
+
+  long double ideal = (long double)bpm / 60.0L * (long double)samples / sampleRate;
+  long double actual = (long double)beats + std::ldexp((long double)oscillator.phaseAccumulator, -64);
+  long double drift = actual - ideal;
+  long double bound = std::ldexp((long double)samples, -65) + std::fabs(ideal) * 1e-15L;
+  bool ok = exact && std::fabs(drift) <= bound;
+
+  printf("%6.0f Hz %7.1f BPM %5.1f h: %11" PRId64 " beats, drift %+.3Le cycles (%+.3Le samples)%s\n",
+         sampleRate, bpm, hours, beats, drift, drift / ((long double)std::fabs(bpm) / 60.0L / sampleRate),
+         ok ? "" : exact ? "  FAILED: drift beyond the increment rounding" : "  FAILED: steps lost");
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  double hours = 24.0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--hours") && i + 1 < argc) {
+      hours = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "Usage: %s [--hours h]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  bool ok = true;
+  for (float sampleRate : sampleRates) {
+    for (double bpm : tempos) {
+      ok &= run(sampleRate, bpm, hours);
+    }
+  }
+  printf(ok ? "No drift\n" : "Drift detected\n");
+  return ok ? 0 : 1;
+}
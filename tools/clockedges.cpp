@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "FixedPointPhase.hpp"
+#include "Groove.hpp"
+
+/*
+ * Checks how well the Clock predicts its next beat, x2 and x4 edges while the
+ * tempo changes. The phase and the groove are stepped the way Clock steps them
+ * and GrooveEngine::predictRises is asked every sample, as in
+ * Clock::predictEdges. Each edge is then timed from the double precision phase
+ * and compared with every prediction made since the previous one:
+ *
+ * - at a steady tempo, and right after a step or a reversal, the predictions
+ *   have to be exact up to their float resolution;
+ * - during a ramp, they may only be off by what assuming a steady tempo costs,
+ *   a * h * (h + 1) / (2 * c) samples for h samples ahead.
+ *
+ *   clockedges
+ */
+
+static const double sampleRate = 48000.0;
+static const double tolerance = 0.01; // samples, the resolution of a float prediction a beat ahead
+
+struct Scenario {
+  const char *name;
+  double from; // BPM, negative runs backwards
+  double to;
+  double changeAt; // seconds
+  double rampSeconds; // 0 for a step
+  float swing8ths;
+  float swing16ths;
+  double seconds;
+
+  double bpm(double time) const {
+    if (time < this->changeAt) { return this->from; }
+    if (this->rampSeconds <= 0.0) { return this->to; }
+    return this->from + (this->to - this->from) * std::min((time - this->changeAt) / this->rampSeconds, 1.0);
+  }
+};
+
+static const Scenario scenarios[] = {
+  { "steady 120", 120.0, 120.0, 0.0, 0.0, 0.5f, 0.5f, 20.0 },
+  { "steady 97.3 swung", 97.3, 97.3, 0.0, 0.0, 0.62f, 0.58f, 20.0 },
+  { "step 120 to 140", 120.0, 140.0, 5.0037, 0.0, 0.5f, 0.5f, 20.0 },
+  { "step 140 to 61.7 swung", 140.0, 61.7, 5.0037, 0.0, 0.57f, 0.66f, 20.0 },
+  { "ramp 120 to 180", 120.0, 180.0, 0.0, 20.0, 0.5f, 0.5f, 20.0 },
+  { "ramp 140 to 60 swung", 140.0, 60.0, 0.0, 20.0, 0.6f, 0.55f, 20.0 },
+  { "reverse 120 to -120", 120.0, -120.0, 5.0013, 0.0, 0.5f, 0.5f, 20.0 },
+  { "reverse -90 to 130 swung", -90.0, 130.0, 7.4141, 0.0, 0.64f, 0.5f, 20.0 },
+};
+
+static const char *outputNames[] = { "beat", "x2", "x4" };
+
+struct Stats {
+  int edges = 0;
+  double maxError[3] = {}; // up to 10 samples ahead, up to 1000, any
+  double worstExcess = -1e9; // of the error over what is allowed, the check fails above 0
+};
+
+static bool run(const Scenario &scenario) {
+  FixedPointPhase oscillator;
+  GrooveEngine groove;
+  groove.build(GrooveTemplate(), scenario.swing8ths, scenario.swing16ths);
+  double dt = 1.0 / sampleRate;
+  long samples = (long)(scenario.seconds * sampleRate);
+  long changeSample = (long)std::ceil(scenario.changeAt * sampleRate);
+  // Change of the tempo per sample during the ramp and its slowest speed, both in cycles per sample
+  double ramp = scenario.rampSeconds > 0.0 ? std::abs(scenario.to - scenario.from) / 60.0 / scenario.rampSeconds * dt * dt : 0.0;
+  double slowest = std::min(std::abs(scenario.from), std::abs(scenario.to)) / 60.0 * dt;
+
+  std::vector<float> predictions[3];
+  for (int output = 0; output < 3; output++) { predictions[output].resize(samples); }
+  long lastEdge[3] = { 0, 0, 0 };
+  Stats stats[3];
+
+  auto score = [&](int output, long sample, double offset) {
+    double time = sample - offset;
+    for (long made = lastEdge[output]; made < sample; made++) {
+      // Made before a step or a reversal, which they cannot know about
+      if (made < changeSample && time > changeSample) { continue; }
+      double ahead = time - made;
+      double error = std::abs(made + (double)predictions[output][made] - time);
+      double allowed = tolerance + 1.1 * ramp * ahead * (ahead + 1.0) / (2.0 * slowest);
+      stats[output].maxError[0] = ahead <= 10.0 ? std::max(stats[output].maxError[0], error) : stats[output].maxError[0];
+      stats[output].maxError[1] = ahead <= 1000.0 ? std::max(stats[output].maxError[1], error) : stats[output].maxError[1];
+      stats[output].maxError[2] = std::max(stats[output].maxError[2], error);
+      stats[output].worstExcess = std::max(stats[output].worstExcess, error - allowed);
+    }
+    stats[output].edges++;
+    lastEdge[output] = sample;
+  };
+
+  for (long sample = 0; sample < samples; sample++) {
+    float bpm = (float)scenario.bpm(sample * dt);
+    oscillator.setPitch(bpm / 60.0);
+    double lastPhase = std::ldexp((double)oscillator.phaseAccumulator, -64);
+    bool flipped = oscillator.step(dt);
+    double phase = std::ldexp((double)oscillator.phaseAccumulator, -64);
+    double cyclesPerSample = std::ldexp((double)oscillator.phaseIncrement(dt), -64);
+
+    // As in Clock::process, a wrap is an edge of all three outputs and the groove only follows it
+    if (flipped) {
+      double past = cyclesPerSample > 0.0 ? phase : 1.0 - phase;
+      double offset = past / std::abs(cyclesPerSample);
+      for (int output = 0; output < 3; output++) { score(output, sample, offset); }
+      groove.seek(oscillator.phase);
+    } else {
+      groove.advance(oscillator.phase, [&](const GrooveEngine::Event &event) {
+        double offset = (phase - event.phase) / (phase - lastPhase);
+        if (event.rises & GrooveEngine::X2_OUTPUT) { score(1, sample, offset); }
+        if (event.rises & GrooveEngine::X4_OUTPUT) { score(2, sample, offset); }
+      });
+    }
+
+    float edges[3];
+    groove.predictRises(phase, cyclesPerSample, edges);
+    for (int output = 0; output < 3; output++) { predictions[output][sample] = edges[output]; }
+  }
+
+  bool ok = true;
+  for (int output = 0; output < 3; output++) {
+    const Stats &s = stats[output];
+    bool passed = s.edges > 0 && s.worstExcess <= 0.0;
+    ok &= passed;
+    printf("%-26s %-4s %5d edges  max error %.2e / %.2e / %.2e samples%s\n",
+           output == 0 ? scenario.name : "", outputNames[output], s.edges, s.maxError[0], s.maxError[1], s.maxError[2],
+           passed ? "" : "  FAILED");
+  }
+  return ok;
+}
+
+int main() {
+  printf("%-26s %-4s %5s        %s\n", "", "", "", "up to 10, 1000 and any samples ahead");
+  bool ok = true;
+  for (const Scenario &scenario : scenarios) {
+    ok &= run(scenario);
+  }
+  printf(ok ? "All predictions within bounds\n" : "Predictions out of bounds\n");
+  return ok ? 0 : 1;
+}
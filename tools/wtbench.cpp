@@ -0,0 +1,551 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "dsp/Wavetable.hpp"
+#include "dsp/WavetableBank.hpp"
+#include "dsp/WavetableRead.hpp"
+#include "filetypes/WavSupport.hpp"
+
+#if !ARCH_WIN
+#include <sys/resource.h>
+#endif
+
+/*
+ * Measures SurgeStorage::load_wt, Wavetable::BuildWT and Wavetable::MipMapWT
+ * (full and preview quality) on synthetic wavetables of various shapes and file layouts, the cost of
+ * rendering a sample with each oversampling factor and table storage, and how
+ * much precision half float storage loses.
+ *
+ *   wtbench [-n iterations] [-d tmpdir] [--quick] [--json]
+ */
+
+namespace fs = std::filesystem;
+
+enum Layout {
+  LAYOUT_CLM,
+  LAYOUT_CUE,
+  LAYOUT_SMPL,
+  LAYOUT_WT,
+  LAYOUT_ZWT,
+};
+
+static const char *layoutNames[] = { "clm", "cue", "smpl", "wt", "zwt" };
+
+struct BenchCase {
+  int size;
+  int frames;
+  bool isFloat;
+  Layout layout;
+};
+
+struct BenchResult {
+  BenchCase bench;
+  uint64_t fileBytes = 0;
+  double load = 0.0;
+  double parse = 0.0;
+  double convert = 0.0;
+  double mipmap = 0.0;
+  double fastMipmap = 0.0; // preview levels the player builds first
+  double bytesPerSecond = 0.0;
+  long peakRssKb = -1;
+  bool ok = false;
+};
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  size_t half = values.size() / 2;
+  return values.size() % 2 ? values[half] : 0.5 * (values[half - 1] + values[half]);
+}
+
+static void resetPeakRss() {
+#if ARCH_LIN
+  // Resets VmHWM so that every case reports its own peak
+  FILE *f = fopen("/proc/self/clear_refs", "w");
+  if (f) {
+    fputs("5", f);
+    fclose(f);
+  }
+#endif
+}
+
+static long peakRssKb() {
+#if ARCH_LIN
+  FILE *f = fopen("/proc/self/status", "r");
+  if (f) {
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), f)) {
+      if (strncmp(line, "VmHWM:", 6) == 0) {
+        kb = atol(line + 6);
+        break;
+      }
+    }
+    fclose(f);
+    if (kb >= 0) { return kb; }
+  }
+#endif
+#if ARCH_WIN
+  return -1;
+#else
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#if ARCH_MAC
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
+
+/* Synthetic content: every frame is a different mix of a few harmonics */
+
+static std::vector<float> makeFrames(int size, int frames) {
+  std::vector<float> samples((size_t)size * frames);
+  for (int f = 0; f < frames; f++) {
+    float morph = frames > 1 ? (float)f / (frames - 1) : 0.f;
+    for (int i = 0; i < size; i++) {
+      float phase = 2.f * M_PI * i / size;
+      float value = (1.f - morph) * sinf(phase) + 0.5f * morph * sinf(3.f * phase) +
+        0.25f * morph * morph * sinf(7.f * phase);
+      samples[(size_t)f * size + i] = 0.6f * value;
+    }
+  }
+  return samples;
+}
+
+static std::vector<char> encodeSamples(const std::vector<float> &samples, bool isFloat) {
+  std::vector<char> data(samples.size() * (isFloat ? sizeof(float) : sizeof(short)));
+  if (isFloat) {
+    memcpy(data.data(), samples.data(), data.size());
+  } else {
+    short *out = (short *)data.data();
+    for (size_t i = 0; i < samples.size(); i++) {
+      out[i] = (short)lrintf(samples[i] * 32767.f);
+    }
+  }
+  return data;
+}
+
+static void put32(std::vector<char> &out, uint32_t value) {
+  for (int i = 0; i < 4; i++) { out.push_back((char)((value >> (i * 8)) & 0xff)); }
+}
+
+static void put16(std::vector<char> &out, uint16_t value) {
+  out.push_back((char)(value & 0xff));
+  out.push_back((char)(value >> 8));
+}
+
+static void putChunk(std::vector<char> &out, const char *tag, const std::vector<char> &body) {
+  out.insert(out.end(), tag, tag + 4);
+  put32(out, body.size());
+  out.insert(out.end(), body.begin(), body.end());
+  if (body.size() % 2) { out.push_back(0); }
+}
+
+static std::vector<char> makeWav(const BenchCase &bench, const std::vector<char> &data) {
+  std::vector<char> fmt;
+  int bits = bench.isFloat ? 32 : 16;
+  put16(fmt, bench.isFloat ? 3 : 1);
+  put16(fmt, 1);
+  put32(fmt, 44100);
+  put32(fmt, 44100 * bits / 8);
+  put16(fmt, bits / 8);
+  put16(fmt, bits);
+
+  std::vector<char> meta;
+  const char *metaTag = nullptr;
+  if (bench.layout == LAYOUT_CLM) {
+    std::string clm = "<!>2048 10000000 wavetable (wtbench)";
+    meta.assign(clm.begin(), clm.end());
+    metaTag = "clm ";
+  } else if (bench.layout == LAYOUT_CUE) {
+    put32(meta, bench.frames);
+    for (int f = 0; f < bench.frames; f++) {
+      put32(meta, f);
+      put32(meta, 0);
+      meta.insert(meta.end(), { 'd', 'a', 't', 'a' });
+      put32(meta, 0);
+      put32(meta, 0);
+      put32(meta, f * bench.size);
+    }
+    metaTag = "cue ";
+  } else if (bench.layout == LAYOUT_SMPL) {
+    for (int i = 0; i < 7; i++) { put32(meta, 0); }
+    put32(meta, 1);
+    put32(meta, 0);
+    put32(meta, 0);
+    put32(meta, 0);
+    put32(meta, 0);
+    put32(meta, bench.size - 1);
+    put32(meta, 0);
+    put32(meta, 0);
+    metaTag = "smpl";
+  }
+
+  std::vector<char> chunks = { 'W', 'A', 'V', 'E' };
+  putChunk(chunks, "fmt ", fmt);
+  if (metaTag) { putChunk(chunks, metaTag, meta); }
+  putChunk(chunks, "data", data);
+
+  std::vector<char> out = { 'R', 'I', 'F', 'F' };
+  put32(out, chunks.size());
+  out.insert(out.end(), chunks.begin(), chunks.end());
+  return out;
+}
+
+static std::vector<char> makeWt(const BenchCase &bench, const std::vector<char> &data) {
+  wt_header header;
+  memcpy(header.tag, "vawt", 4);
+  header.n_samples = bench.size;
+  header.n_tables = bench.frames;
+  header.flags = bench.isFloat ? 0 : wtf_int16;
+  std::vector<char> out((char *)&header, (char *)&header + sizeof(wt_header));
+  out.insert(out.end(), data.begin(), data.end());
+  return out;
+}
+
+static bool writeFile(const fs::path &path, const std::vector<char> &bytes) {
+  FILE *f = fopen(path.string().c_str(), "wb");
+  if (!f) { return false; }
+  bool written = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+  return (fclose(f) == 0) && written;
+}
+
+static BenchResult runCase(const BenchCase &bench, const fs::path &dir, int iterations) {
+  BenchResult result;
+  result.bench = bench;
+
+  std::vector<char> data = encodeSamples(makeFrames(bench.size, bench.frames), bench.isFloat);
+  wt_header header;
+  memcpy(header.tag, "vawt", 4);
+  header.n_samples = bench.size;
+  header.n_tables = bench.frames;
+  header.flags = bench.isFloat ? 0 : wtf_int16;
+
+  char name[64];
+  snprintf(
+    name, sizeof(name), "%d_%d_%s.%s",
+    bench.size, bench.frames, bench.isFloat ? "f32" : "i16", bench.layout == LAYOUT_ZWT ? "zwt" : (bench.layout == LAYOUT_WT ? "wt" : "wav")
+  );
+  fs::path path = dir / name;
+  if (bench.layout == LAYOUT_ZWT) {
+    std::unique_ptr<Wavetable> source(new Wavetable());
+    if (!source->BuildWT(data.data(), header, false) || !writeWavetableBank(source.get(), path.string())) {
+      return result;
+    }
+  } else {
+    bool written = writeFile(path, bench.layout == LAYOUT_WT ? makeWt(bench, data) : makeWav(bench, data));
+    if (!written) { return result; }
+  }
+  std::error_code ec;
+  result.fileBytes = fs::file_size(path, ec);
+
+  std::vector<double> loads, converts, mipmaps, fastMipmaps;
+  resetPeakRss();
+  for (int i = 0; i < iterations; i++) {
+    std::unique_ptr<Wavetable> wt(new Wavetable());
+    SurgeStorage storage;
+    auto start = std::chrono::steady_clock::now();
+    bool loaded = storage.load_wt(path.string(), wt.get());
+    loads.push_back(millisecondsSince(start));
+    if (!loaded || wt->size != bench.size || wt->n_data_tables != bench.frames) {
+      fs::remove(path, ec);
+      return result;
+    }
+
+    // Same stages the loader runs, timed separately on the in-memory samples
+    if (bench.layout == LAYOUT_ZWT) {
+      converts.push_back(0.0);
+      mipmaps.push_back(0.0);
+      fastMipmaps.push_back(0.0);
+      continue;
+    }
+    std::unique_ptr<Wavetable> staged(new Wavetable());
+    start = std::chrono::steady_clock::now();
+    staged->BuildWT(data.data(), header, false, false);
+    converts.push_back(millisecondsSince(start));
+    start = std::chrono::steady_clock::now();
+    staged->MipMapWT();
+    mipmaps.push_back(millisecondsSince(start));
+    std::unique_ptr<Wavetable> preview(new Wavetable());
+    preview->BuildWT(data.data(), header, false, false);
+    start = std::chrono::steady_clock::now();
+    preview->MipMapWT(true);
+    fastMipmaps.push_back(millisecondsSince(start));
+  }
+  result.peakRssKb = peakRssKb();
+  fs::remove(path, ec);
+
+  result.load = median(loads);
+  result.convert = median(converts);
+  result.mipmap = median(mipmaps);
+  result.fastMipmap = median(fastMipmaps);
+  result.parse = std::max(0.0, result.load - result.convert - result.mipmap);
+  result.bytesPerSecond = result.load > 0.0 ? result.fileBytes / (result.load / 1000.0) : 0.0;
+  result.ok = true;
+  return result;
+}
+
+enum IndexMode { INDEX_SWEEP, INDEX_SWEEP_NEAREST, INDEX_STATIC, INDEX_MODES };
+static const char *indexModeNames[] = { "sweep", "nearest", "static" };
+
+struct PlaybackResult {
+  int factor;
+  IndexMode indexMode;
+  bool half;
+  double nsPerSample;
+};
+
+// Audio-rate phase modulation with a fast index sweep, as in the worst case for
+// aliasing; out gets the rendered samples if given
+static PlaybackResult runPlayback(Wavetable *wt, int factor, IndexMode indexMode, int samples, std::vector<float> *out = nullptr) {
+  WavetableReader reader;
+  reader.indexInterpolation = indexMode != INDEX_SWEEP_NEAREST;
+  double sampleRate = 48000.0;
+  double carrier = 0.0;
+  double modulator = 0.0;
+  float sum = 0.f;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < samples; i++) {
+    carrier += 220.0 / sampleRate;
+    modulator += 1760.0 / sampleRate;
+    carrier -= std::floor(carrier);
+    modulator -= std::floor(modulator);
+    float phase = carrier + 0.3 * sin(2.0 * M_PI * modulator);
+    phase -= std::floor(phase);
+    float index = indexMode == INDEX_STATIC ? 0.37f : 0.5f + 0.5f * sinf(2.f * M_PI * 50.f * i / sampleRate);
+    float wave = reader.process(wt, index, 0.f, phase, true, factor);
+    sum += wave;
+    if (out) { out->push_back(wave); }
+  }
+  double elapsed = millisecondsSince(start);
+  // Keeps the loop from being optimized away
+  if (sum == 12345.f) { fprintf(stderr, " "); }
+  return { factor, indexMode, wt->TableF16Data != nullptr, elapsed * 1e6 / samples };
+}
+
+struct PrecisionResult {
+  int level; // -1 for the rendered output
+  int size;
+  double maxError;
+  double snrDb;
+};
+
+static PrecisionResult compareSignals(int level, int size, const std::vector<float> &reference, const std::vector<float> &test) {
+  double signal = 0.0;
+  double noise = 0.0;
+  double maxError = 0.0;
+  for (size_t i = 0; i < reference.size(); i++) {
+    double error = (double)test[i] - reference[i];
+    signal += (double)reference[i] * reference[i];
+    noise += error * error;
+    maxError = std::max(maxError, std::fabs(error));
+  }
+  double snrDb = noise > 0.0 ? 10.0 * std::log10(signal / noise) : INFINITY;
+  return { level, size, maxError, snrDb };
+}
+
+// Every mipmap level of the half table against the float one, then the output of both
+static std::vector<PrecisionResult> runPrecision(Wavetable *wt, Wavetable *half, int samples) {
+  std::vector<PrecisionResult> precision;
+  // Down to the smallest level the reader picks
+  for (int level = 0; (wt->size >> level) >= 4 && level < max_mipmap_levels; level++) {
+    int lsize = wt->size >> level;
+    std::vector<float> reference(lsize * wt->n_tables);
+    std::vector<float> test(lsize * wt->n_tables);
+    for (int j = 0; j < wt->n_tables; j++) {
+      wt->ReadFrame(level, j, &reference[j * lsize]);
+      half->ReadFrame(level, j, &test[j * lsize]);
+    }
+    precision.push_back(compareSignals(level, lsize, reference, test));
+  }
+  std::vector<float> reference;
+  std::vector<float> test;
+  runPlayback(wt, 1, INDEX_SWEEP, samples, &reference);
+  runPlayback(half, 1, INDEX_SWEEP, samples, &test);
+  precision.push_back(compareSignals(-1, wt->size, reference, test));
+  return precision;
+}
+
+static void printTable(const std::vector<BenchResult> &results) {
+  printf(
+    "%-6s %5s %6s %4s %10s %10s %10s %10s %10s %10s %10s %9s\n",
+    "layout", "size", "frames", "fmt", "bytes", "load ms", "parse ms", "convert ms", "mipmap ms", "fast ms", "MB/s", "peak MB"
+  );
+  for (const BenchResult &r : results) {
+    if (!r.ok) {
+      printf(
+        "%-6s %5d %6d %4s FAILED\n",
+        layoutNames[r.bench.layout], r.bench.size, r.bench.frames, r.bench.isFloat ? "f32" : "i16"
+      );
+      continue;
+    }
+    printf(
+      "%-6s %5d %6d %4s %10llu %10.3f %10.3f %10.3f %10.3f %10.3f %10.1f %9.1f\n",
+      layoutNames[r.bench.layout], r.bench.size, r.bench.frames, r.bench.isFloat ? "f32" : "i16",
+      (unsigned long long)r.fileBytes, r.load, r.parse, r.convert, r.mipmap, r.fastMipmap,
+      r.bytesPerSecond / 1e6, r.peakRssKb / 1024.0
+    );
+  }
+}
+
+static void printPlayback(const std::vector<PlaybackResult> &playback) {
+  printf("\n%-12s %-8s %-7s %12s\n", "oversampling", "index", "storage", "ns/sample");
+  for (const PlaybackResult &p : playback) {
+    printf("%-12d %-8s %-7s %12.2f\n", p.factor, indexModeNames[p.indexMode], p.half ? "f16" : "f32", p.nsPerSample);
+  }
+}
+
+static void printPrecision(const std::vector<PrecisionResult> &precision, size_t floatBytes, size_t halfBytes) {
+  printf("\nstorage f32 %zu bytes, f16 %zu bytes\n", floatBytes, halfBytes);
+  printf("%-8s %6s %12s %10s\n", "f16 vs", "size", "max error", "SNR dB");
+  for (const PrecisionResult &p : precision) {
+    char name[32] = "output";
+    if (p.level >= 0) { snprintf(name, sizeof(name), "level %d", p.level); }
+    printf("%-8s %6d %12.3g %10.1f\n", name, p.size, p.maxError, p.snrDb);
+  }
+}
+
+static void printJson(
+  const std::vector<BenchResult> &results, const std::vector<PlaybackResult> &playback,
+  const std::vector<PrecisionResult> &precision, size_t floatBytes, size_t halfBytes, int iterations
+) {
+  printf("{\n  \"iterations\": %d,\n  \"playback\": [\n", iterations);
+  for (size_t i = 0; i < playback.size(); i++) {
+    printf(
+      "    {\"oversampling\": %d, \"index\": \"%s\", \"storage\": \"%s\", \"ns_per_sample\": %.3f}%s\n",
+      playback[i].factor, indexModeNames[playback[i].indexMode], playback[i].half ? "f16" : "f32",
+      playback[i].nsPerSample, i + 1 < playback.size() ? "," : ""
+    );
+  }
+  printf("  ],\n  \"storage_bytes\": {\"f32\": %zu, \"f16\": %zu},\n  \"half_precision\": [\n", floatBytes, halfBytes);
+  for (size_t i = 0; i < precision.size(); i++) {
+    printf(
+      "    {\"level\": %d, \"size\": %d, \"max_error\": %.6g, \"snr_db\": %.2f}%s\n",
+      precision[i].level, precision[i].size, precision[i].maxError, precision[i].snrDb, i + 1 < precision.size() ? "," : ""
+    );
+  }
+  printf("  ],\n  \"results\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult &r = results[i];
+    printf(
+      "    {\"layout\": \"%s\", \"size\": %d, \"frames\": %d, \"format\": \"%s\", \"ok\": %s, "
+      "\"bytes\": %llu, \"load_ms\": %.4f, \"parse_ms\": %.4f, \"convert_ms\": %.4f, \"mipmap_ms\": %.4f, "
+      "\"fast_mipmap_ms\": %.4f, \"bytes_per_second\": %.0f, \"peak_rss_kb\": %ld}%s\n",
+      layoutNames[r.bench.layout], r.bench.size, r.bench.frames, r.bench.isFloat ? "f32" : "i16",
+      r.ok ? "true" : "false", (unsigned long long)r.fileBytes, r.load, r.parse, r.convert, r.mipmap,
+      r.fastMipmap, r.bytesPerSecond, r.peakRssKb, i + 1 < results.size() ? "," : ""
+    );
+  }
+  printf("  ]\n}\n");
+}
+
+static void usage() {
+  fprintf(stderr, "Usage: wtbench [-n iterations] [-d tmpdir] [--quick] [--json]\n");
+}
+
+int main(int argc, char **argv) {
+  int iterations = 5;
+  bool json = false;
+  bool quick = false;
+  std::error_code ec;
+  fs::path dir = fs::temp_directory_path(ec);
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      iterations = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+      dir = argv[++i];
+    } else if (strcmp(argv[i], "--json") == 0) {
+      json = true;
+    } else if (strcmp(argv[i], "--quick") == 0) {
+      quick = true;
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  dir /= "wtbench";
+  fs::create_directories(dir, ec);
+
+  std::vector<int> sizes = quick ? std::vector<int>{ 256, 2048 } : std::vector<int>{ 256, 1024, 2048, 4096 };
+  std::vector<int> frameCounts = quick ? std::vector<int>{ 16, 256 } : std::vector<int>{ 16, 64, 256 };
+  std::vector<BenchCase> cases;
+  for (int layout = LAYOUT_CLM; layout <= LAYOUT_ZWT; layout++) {
+    for (int size : sizes) {
+      // The loader only recognizes 2048 sample clm frames
+      if (layout == LAYOUT_CLM && size != 2048) { continue; }
+      for (int frames : frameCounts) {
+        // Tables that do not fit the storage are refused by the loaders
+        if (frames + 3 > MaxWTFrames(size)) { continue; }
+        for (int isFloat = 0; isFloat < 2; isFloat++) {
+          cases.push_back({ size, frames, (bool)isFloat, (Layout)layout });
+        }
+      }
+    }
+  }
+
+  // The loaders report every chunk they meet on std::cout
+  std::cout.setstate(std::ios::failbit);
+
+  std::vector<BenchResult> results;
+  for (const BenchCase &bench : cases) {
+    results.push_back(runCase(bench, dir, iterations));
+  }
+  fs::remove(dir, ec);
+
+  std::vector<PlaybackResult> playback;
+  std::vector<PrecisionResult> precision;
+  size_t floatBytes = 0;
+  size_t halfBytes = 0;
+  {
+    BenchCase bench = { 2048, 64, true, LAYOUT_WT };
+    std::vector<char> data = encodeSamples(makeFrames(bench.size, bench.frames), true);
+    wt_header header;
+    memcpy(header.tag, "vawt", 4);
+    header.n_samples = bench.size;
+    header.n_tables = bench.frames;
+    header.flags = 0;
+    std::unique_ptr<Wavetable> wt(new Wavetable());
+    wt->BuildWT(data.data(), header, false);
+    std::unique_ptr<Wavetable> half(new Wavetable());
+    half->BuildWT(data.data(), header, false);
+    half->ConvertToHalf();
+    floatBytes = wt->accounted_bytes;
+    halfBytes = half->accounted_bytes;
+    int samples = quick ? 48000 : 480000;
+    for (Wavetable *table : { wt.get(), half.get() }) {
+      for (int factor : { 1, 2, 4 }) {
+        for (int mode = 0; mode < INDEX_MODES; mode++) {
+          playback.push_back(runPlayback(table, factor, (IndexMode)mode, samples));
+        }
+      }
+    }
+    precision = runPrecision(wt.get(), half.get(), samples);
+  }
+
+  if (json) {
+    printJson(results, playback, precision, floatBytes, halfBytes, iterations);
+  } else {
+    printTable(results);
+    printPlayback(playback);
+    printPrecision(precision, floatBytes, halfBytes);
+  }
+  for (const BenchResult &r : results) {
+    if (!r.ok) { return 2; }
+  }
+  return 0;
+}
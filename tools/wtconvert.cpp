@@ -0,0 +1,200 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "dsp/Wavetable.hpp"
+#include "dsp/WavetableBank.hpp"
+#include "dsp/WavetableGrid.hpp"
+#include "filetypes/WavSupport.hpp"
+#include "WorkerPool.hpp"
+
+/*
+ * Batch converts .wav and .wt wavetables into pre-mipmapped .zwt banks that
+ * the player maps straight from disk.
+ *
+ *   wtconvert [-j threads] [-o outdir] [-s] [-q fast|high] [-g grid.zwt] <file or directory>...
+ *
+ * -s slices .wav files without loop metadata into single cycles by pitch.
+ * -q picks the resampling quality for frames that are not a power of two long.
+ * -g writes all inputs as the rows of a single 2D grid bank instead, in path order.
+ */
+
+namespace fs = std::filesystem;
+
+struct ConvertJob {
+  fs::path input;
+  fs::path output;
+};
+
+static bool isWavetableFile(const fs::path &path) {
+  std::string extension = path.extension().string();
+  for (char &c : extension) { c = tolower(c); }
+  return extension == ".wav" || extension == ".wt";
+}
+
+static void collectJobs(const fs::path &input, const fs::path &outDir, std::vector<ConvertJob> &jobs) {
+  std::error_code ec;
+  if (fs::is_directory(input, ec)) {
+    for (auto it = fs::recursive_directory_iterator(input, fs::directory_options::skip_permission_denied, ec);
+         it != fs::recursive_directory_iterator(); it.increment(ec)) {
+      if (ec) { break; }
+      if (!it->is_regular_file(ec) || !isWavetableFile(it->path())) { continue; }
+      fs::path output = outDir.empty() ? it->path() : outDir / fs::relative(it->path(), input, ec);
+      jobs.push_back({ it->path(), output.replace_extension(".zwt") });
+    }
+  } else if (fs::is_regular_file(input, ec) && isWavetableFile(input)) {
+    fs::path output = outDir.empty() ? input : outDir / input.filename();
+    jobs.push_back({ input, output.replace_extension(".zwt") });
+  } else {
+    fprintf(stderr, "Skipping %s: not a wavetable file or directory\n", input.string().c_str());
+  }
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void usage() {
+  fprintf(stderr, "Usage: wtconvert [-j threads] [-o outdir] [-s] [-q fast|high] [-g grid.zwt] <file or directory>...\n");
+}
+
+int main(int argc, char **argv) {
+  int threadsCount = WorkerPool::defaultThreadsCount();
+  fs::path outDir;
+  fs::path gridOutput;
+  bool slicePlainWav = false;
+  ResampleQuality resampleQuality = RESAMPLE_HIGH;
+  std::vector<fs::path> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threadsCount = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      outDir = argv[++i];
+    } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+      gridOutput = argv[++i];
+    } else if (strcmp(argv[i], "-s") == 0) {
+      slicePlainWav = true;
+    } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+      const char *quality = argv[++i];
+      if (strcmp(quality, "fast") != 0 && strcmp(quality, "high") != 0) {
+        usage();
+        return 1;
+      }
+      resampleQuality = strcmp(quality, "fast") == 0 ? RESAMPLE_FAST : RESAMPLE_HIGH;
+    } else if (argv[i][0] == '-') {
+      usage();
+      return 1;
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
+  if (inputs.empty()) {
+    usage();
+    return 1;
+  }
+
+  std::vector<ConvertJob> jobs;
+  for (const fs::path &input : inputs) {
+    collectJobs(input, outDir, jobs);
+  }
+  if (jobs.empty()) {
+    fprintf(stderr, "Nothing to convert\n");
+    return 1;
+  }
+
+  // The loaders report every chunk they meet on std::cout
+  std::cout.setstate(std::ios::failbit);
+
+  if (!gridOutput.empty()) {
+    std::sort(jobs.begin(), jobs.end(), [](const ConvertJob &a, const ConvertJob &b) { return a.input < b.input; });
+    if ((int)jobs.size() > maxGridRows) {
+      fprintf(stderr, "Only the first %d of %d file(s) fit in a grid\n", maxGridRows, (int)jobs.size());
+      jobs.resize(maxGridRows);
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<Wavetable>> loaded(jobs.size());
+    {
+      WorkerPool pool(threadsCount);
+      for (size_t i = 0; i < jobs.size(); i++) {
+        pool.enqueue([&jobs, &loaded, i, slicePlainWav, resampleQuality]() {
+          std::shared_ptr<Wavetable> wt = std::make_shared<Wavetable>();
+          SurgeStorage storage;
+          storage.slicePlainWav = slicePlainWav;
+          storage.resampleQuality = resampleQuality;
+          if (storage.load_wt(jobs[i].input.string(), wt.get())) {
+            loaded[i] = wt;
+          }
+        });
+      }
+      pool.wait();
+    }
+    std::vector<std::shared_ptr<Wavetable>> rows;
+    for (size_t i = 0; i < jobs.size(); i++) {
+      if (loaded[i]) {
+        rows.push_back(loaded[i]);
+      } else {
+        printf("FAILED %s\n", jobs[i].input.string().c_str());
+      }
+    }
+    std::unique_ptr<Wavetable> grid(new Wavetable());
+    if (!buildWavetableGrid(rows, grid.get(), resampleQuality) || !writeWavetableBank(grid.get(), gridOutput.string())) {
+      fprintf(stderr, "Could not write %s\n", gridOutput.string().c_str());
+      return 2;
+    }
+    printf(
+      "%8.2f ms %4d x %-4d x %d %s\n",
+      millisecondsSince(start), grid->n_tables / grid->n_rows, grid->size, grid->n_rows, gridOutput.string().c_str()
+    );
+    return rows.size() == jobs.size() ? 0 : 2;
+  }
+
+  std::mutex printMutex;
+  std::atomic<int> failed(0);
+  auto start = std::chrono::steady_clock::now();
+  {
+    WorkerPool pool(threadsCount);
+    for (const ConvertJob &job : jobs) {
+      pool.enqueue([&job, &printMutex, &failed, slicePlainWav, resampleQuality]() {
+        auto jobStart = std::chrono::steady_clock::now();
+        std::unique_ptr<Wavetable> wt(new Wavetable());
+        SurgeStorage storage;
+        storage.slicePlainWav = slicePlainWav;
+        storage.resampleQuality = resampleQuality;
+        std::error_code ec;
+        bool converted = storage.load_wt(job.input.string(), wt.get());
+        double loadTime = millisecondsSince(jobStart);
+        if (converted) {
+          fs::create_directories(job.output.parent_path(), ec);
+          converted = writeWavetableBank(wt.get(), job.output.string());
+        }
+        double totalTime = millisecondsSince(jobStart);
+        std::lock_guard<std::mutex> lock(printMutex);
+        if (converted) {
+          printf(
+            "%8.2f ms (load %7.2f ms) %4d x %-4d %s\n",
+            totalTime, loadTime, wt->n_data_tables, wt->size, job.output.string().c_str()
+          );
+        } else {
+          failed++;
+          printf("%8.2f ms FAILED %s\n", totalTime, job.input.string().c_str());
+        }
+      });
+    }
+    pool.wait();
+  }
+
+  printf(
+    "Converted %d of %d file(s) in %.2f ms on %d thread(s)\n",
+    (int)jobs.size() - failed.load(), (int)jobs.size(), millisecondsSince(start), threadsCount
+  );
+  return failed.load() == 0 ? 0 : 2;
+}